@@ -0,0 +1,78 @@
+/*
+ * Heap allocations per sale, before and after the SaleView path.
+ *
+ *   legacy : Inventory::sellProduct(id, qty, Product&) + Reciept::addItem(name, qty, price)
+ *   view   : Inventory::sellProduct(id, qty, SaleView&) + Reciept::addItem(SaleView)
+ *   basket : Inventory::sellBatch over three lines (scratch vectors from the TransactionArena)
+ *
+ * Build: g++ -std=c++20 -O2 -pthread bench/alloc_per_sale.cpp -o alloc_per_sale
+ */
+#define SUPERMARKET_NO_MAIN
+#include "../main.cpp"
+
+#include <atomic>
+#include <new>
+
+static atomic<size_t> allocations{0};
+
+// Out of line for the same reason as the counting allocator in main.cpp.
+[[gnu::noinline]] void* operator new(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* p) noexcept { free(p); }
+[[gnu::noinline]] void operator delete(void* p, size_t) noexcept { free(p); }
+
+static const int catalogSize = 1000;
+static const int sales = 100000;
+
+static void fillCatalog(Inventory& inventory) {
+    inventory.setEventSink(NullInventoryEvents::instance());
+    for (int id = 1; id <= catalogSize; ++id) {
+        // Longer than the small-string buffer, like most real product names.
+        inventory.loadProduct(id, "Organic Whole Milk 1L #" + to_string(id), 100, 1.99);
+    }
+}
+
+template <typename Sell>
+static double measure(const char* label, Sell sell) {
+    Inventory inventory;
+    fillCatalog(inventory);
+    Reciept receipt;
+    receipt.reserve(sales * 3);
+
+    size_t before = allocations.load();
+    for (int i = 0; i < sales; ++i) {
+        int id = 1 + (i * 7919) % catalogSize;
+        if (!sell(inventory, receipt, id)) {
+            inventory.restockProduct(id, 100);
+            sell(inventory, receipt, id);
+        }
+    }
+    double perSale = static_cast<double>(allocations.load() - before) / sales;
+    cout << label << ": " << perSale << " allocations per sale\n";
+    return perSale;
+}
+
+int main() {
+    double legacy = measure("legacy", [](Inventory& inv, Reciept& rec, int id) {
+        Product sold;
+        if (!inv.sellProduct(id, 1, sold)) return false;
+        rec.addItem(sold.name, 1, sold.price);
+        return true;
+    });
+    double view = measure("view  ", [](Inventory& inv, Reciept& rec, int id) {
+        SaleView sold;
+        if (!inv.sellProduct(id, 1, sold)) return false;
+        rec.addItem(sold);
+        return true;
+    });
+    double basket = measure("basket", [](Inventory& inv, Reciept& rec, int id) {
+        int next = 1 + id % catalogSize;
+        const LineItem lines[] = {{id, 1}, {next, 1}, {id, 1}};
+        return inv.sellBatch(lines, rec);
+    });
+    return view <= legacy && basket < 1.0 ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+/*
+ * Stress test for ConcurrentInventory: lanes sell and restock random products while
+ * a reader takes snapshots. Checks that every stock level stays within
+ * 0..capacity and that units are conserved (initial + restocked - sold).
+ * Exits non-zero on any violation. Also reports the slowest single operation,
+ * which includes any shard copy a write does for a pending snapshot.
+ *
+ * Build: g++ -std=c++20 -O2 -pthread bench/concurrent_stress.cpp -o concurrent_stress
+ * Run:   ./concurrent_stress [lanes=8] [operations per lane=200000] [products=1000]
+ */
+#define SUPERMARKET_NO_MAIN
+#include "../main.cpp"
+
+#include <random>
+
+int main(int argc, char* argv[]) {
+    int lanes = argc > 1 ? atoi(argv[1]) : 8;
+    int operations = argc > 2 ? atoi(argv[2]) : 200000;
+    int catalogSize = argc > 3 ? atoi(argv[3]) : 1000;
+
+    // Every fourth product is a pallet line, so both capacities are exercised.
+    StockLimitTable limits;
+    limits.defineClass("pallet", StockLimits{500, 100});
+    for (int id = 4; id <= catalogSize; id += 4) limits.assign(id, "pallet");
+
+    ConcurrentInventory store;
+    store.setEventSink(NullInventoryEvents::instance());
+    store.setStockLimits(limits);
+    long long initial = 0;
+    for (int id = 1; id <= catalogSize; ++id) {
+        int quantity = limits.limitsOf(id).capacity / 2;
+        store.insertProduct(Product{id, "Item " + to_string(id), quantity, 1.0});
+        initial += quantity;
+    }
+
+    atomic<long long> sold{0}, restocked{0};
+    atomic<bool> running{true};
+    atomic<size_t> violations{0};
+    atomic<long long> worstNanos{0};
+
+    // Snapshots must always be within bounds and agree with their own totals.
+    thread reader([&] {
+        while (running.load()) {
+            auto view = store.snapshot();
+            long long units = 0;
+            for (auto& p : view->sortedProducts()) {
+                units += p.quantity;
+                if (p.quantity < 0 || p.quantity > limits.limitsOf(p.id).capacity) ++violations;
+            }
+            if (units != view->totals().units) ++violations;
+        }
+    });
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (int lane = 0; lane < lanes; ++lane) {
+        workers.emplace_back([&, lane] {
+            mt19937 rng(static_cast<unsigned>(lane) * 7919u + 1u);
+            uniform_int_distribution<int> product(1, catalogSize), amount(-2, 40);
+            long long laneSold = 0, laneRestocked = 0, laneWorst = 0;
+            Product taken;
+            for (int i = 0; i < operations; ++i) {
+                int id = product(rng), units = amount(rng); // some invalid amounts on purpose
+                auto begin = chrono::steady_clock::now();
+                if (rng() & 1) {
+                    if (store.sellProduct(id, units, taken)) laneSold += units;
+                } else if (store.restockProduct(id, units)) {
+                    laneRestocked += units;
+                }
+                laneWorst = max<long long>(laneWorst, chrono::nanoseconds(chrono::steady_clock::now() - begin).count());
+            }
+            sold += laneSold;
+            restocked += laneRestocked;
+            long long seen = worstNanos.load();
+            while (laneWorst > seen && !worstNanos.compare_exchange_weak(seen, laneWorst)) {
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    running = false;
+    reader.join();
+
+    long long onHand = 0;
+    for (auto& p : store.sortedProducts()) {
+        onHand += p.quantity;
+        if (p.quantity < 0 || p.quantity > limits.limitsOf(p.id).capacity) ++violations;
+    }
+    long long expected = initial + restocked.load() - sold.load();
+    printf("%d lanes x %d operations in %.2f s: sold %lld, restocked %lld, on hand %lld (expected %lld)\n", lanes,
+           operations, seconds, sold.load(), restocked.load(), onHand, expected);
+    printf("slowest operation %.1f us\n", worstNanos.load() / 1000.0);
+    if (onHand != expected || violations.load() != 0) {
+        printf("FAILED: %zu bound violation(s), unit difference %lld\n", violations.load(), onHand - expected);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
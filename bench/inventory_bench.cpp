@@ -0,0 +1,221 @@
+/*
+ * Google Benchmark suite for the Inventory and Reciept hot paths.
+ *
+ * Build: g++ -std=c++20 -O2 -pthread bench/inventory_bench.cpp -o inventory_bench -lbenchmark
+ * Run:   ./inventory_bench --benchmark_format=json --benchmark_out=bench.json
+ *
+ * Catalog sizes run from 1k to 10M SKUs. IDs are sparse 9-digit SKUs and
+ * sales follow a Zipf-like popularity curve; baskets average about 12 lines.
+ * Everything runs headless: events go to NullInventoryEvents and the
+ * ScreenManager never clears the screen.
+ */
+#define SUPERMARKET_NO_MAIN
+#include "../main.cpp"
+
+#include <benchmark/benchmark.h>
+#include <random>
+
+namespace {
+
+// Sparse but deterministic SKU for catalog position i.
+int skuFor(int64_t i) {
+    return static_cast<int>(100000000 + i * 37);
+}
+
+// Log-uniform rank: P(rank = k) ~ 1/k, i.e. Zipf with s = 1 and no lookup table.
+vector<int> popularIds(int64_t catalog, size_t count, uint32_t seed = 42) {
+    mt19937_64 rng(seed);
+    uniform_real_distribution<double> u(0.0, 1.0);
+    double logN = log(static_cast<double>(catalog));
+    vector<int> ids(count);
+    for (auto& id : ids) {
+        auto rank = static_cast<int64_t>(exp(u(rng) * logN)) - 1;
+        // Scatter ranks over the catalog so hot items are not all neighbours.
+        id = skuFor((rank * 2654435761LL) % catalog);
+    }
+    return ids;
+}
+
+vector<int> basketSizes(size_t count, uint32_t seed = 7) {
+    mt19937 rng(seed);
+    geometric_distribution<int> lines(1.0 / 12.0);
+    vector<int> sizes(count);
+    for (auto& n : sizes) n = min(1 + lines(rng), 60);
+    return sizes;
+}
+
+void fill(Inventory& inventory, int64_t catalog) {
+    inventory.setEventSink(NullInventoryEvents::instance());
+    inventory.reserve(static_cast<size_t>(catalog), static_cast<size_t>(catalog) * 20);
+    string name;
+    for (int64_t i = 0; i < catalog; ++i) {
+        name = "Product ";
+        name += to_string(i);
+        inventory.loadProduct(skuFor(i), name, 100, 0.5 + static_cast<double>(i % 2000) / 100.0);
+    }
+}
+
+// The most recently used catalog is kept, so consecutive benchmarks on one size share setup.
+Inventory& catalogOf(int64_t size) {
+    static unique_ptr<Inventory> catalog;
+    static int64_t catalogSize = 0;
+    if (!catalog || catalogSize != size) {
+        catalog.reset();
+        catalog = make_unique<Inventory>();
+        catalogSize = size;
+        fill(*catalog, size);
+    }
+    return *catalog;
+}
+
+void catalogSizes(benchmark::internal::Benchmark* b) {
+    for (int64_t n = 1000; n <= 10000000; n *= 10) b->Arg(n);
+}
+
+void BM_InsertProduct(benchmark::State& state) {
+    int64_t catalog = state.range(0);
+    vector<Product> products(static_cast<size_t>(min<int64_t>(catalog, 1 << 20)));
+    for (size_t i = 0; i < products.size(); ++i) {
+        products[i] = Product{skuFor(static_cast<int64_t>(i)), "Product " + to_string(i), 50, 1.25};
+    }
+    for (auto _ : state) {
+        Inventory inventory;
+        inventory.setEventSink(NullInventoryEvents::instance());
+        for (int64_t i = 0; i < catalog; ++i) {
+            Product& p = products[static_cast<size_t>(i) % products.size()];
+            p.id = skuFor(i);
+            benchmark::DoNotOptimize(inventory.insertProduct(p));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * catalog);
+}
+BENCHMARK(BM_InsertProduct)->Apply(catalogSizes)->Unit(benchmark::kMillisecond);
+
+void BM_SellProduct(benchmark::State& state) {
+    Inventory& inventory = catalogOf(state.range(0));
+    vector<int> ids = popularIds(state.range(0), 1 << 16);
+    SaleView sold;
+    size_t i = 0;
+    for (auto _ : state) {
+        int id = ids[i++ & (ids.size() - 1)];
+        if (!inventory.sellProduct(id, 1, sold)) inventory.restockProduct(id, 100);
+        benchmark::DoNotOptimize(sold);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SellProduct)->Apply(catalogSizes);
+
+void BM_RestockProduct(benchmark::State& state) {
+    Inventory& inventory = catalogOf(state.range(0));
+    vector<int> ids = popularIds(state.range(0), 1 << 16, 99);
+    SaleView sold;
+    size_t i = 0;
+    for (auto _ : state) {
+        int id = ids[i++ & (ids.size() - 1)];
+        if (!inventory.restockProduct(id, 1)) inventory.sellProduct(id, 50, sold);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RestockProduct)->Apply(catalogSizes);
+
+// Sales against compact IDs 1..n, the case --dense-ids is for; range(1) picks the
+// index (0 = FlatHash, 1 = Dense).
+void BM_SellCompactIds(benchmark::State& state) {
+    int64_t catalog = state.range(0);
+    Inventory inventory(state.range(1) ? IndexMode::Dense : IndexMode::FlatHash);
+    inventory.setEventSink(NullInventoryEvents::instance());
+    inventory.reserve(static_cast<size_t>(catalog), static_cast<size_t>(catalog) * 20);
+    for (int64_t i = 0; i < catalog; ++i) {
+        inventory.loadProduct(static_cast<int>(i + 1), "Product " + to_string(i), 100, 1.0);
+    }
+    vector<int> ids = popularIds(catalog, 1 << 16);
+    for (auto& id : ids) id = (id - skuFor(0)) / 37 + 1;
+    SaleView sold;
+    size_t i = 0;
+    for (auto _ : state) {
+        int id = ids[i++ & (ids.size() - 1)];
+        if (!inventory.sellProduct(id, 1, sold)) inventory.restockProduct(id, 100);
+        benchmark::DoNotOptimize(sold);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SellCompactIds)->ArgsProduct({{1000, 100000, 10000000}, {0, 1}});
+
+void BM_SellBasket(benchmark::State& state) {
+    Inventory& inventory = catalogOf(state.range(0));
+    vector<int> ids = popularIds(state.range(0), 1 << 16, 3);
+    vector<int> sizes = basketSizes(1 << 12);
+    Reciept receipt;
+    receipt.reserve(64);
+    vector<LineItem> basket;
+    size_t next = 0, lines = 0, b = 0;
+    for (auto _ : state) {
+        basket.clear();
+        int n = sizes[b++ & (sizes.size() - 1)];
+        for (int k = 0; k < n; ++k) basket.push_back({ids[next++ & (ids.size() - 1)], 1});
+        if (!inventory.sellBatch(basket, receipt)) {
+            for (auto& line : basket) inventory.restockProduct(line.id, 50);
+        }
+        lines += basket.size();
+        receipt.clear();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(lines));
+}
+BENCHMARK(BM_SellBasket)->Apply(catalogSizes);
+
+void BM_InventoryGetFileContent(benchmark::State& state) {
+    Inventory& inventory = catalogOf(state.range(0));
+    for (auto _ : state) {
+        string content = inventory.getFileContent();
+        benchmark::DoNotOptimize(content.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_InventoryGetFileContent)->Apply(catalogSizes)->Unit(benchmark::kMillisecond);
+
+void BM_ReceiptAddItem(benchmark::State& state) {
+    Inventory& inventory = catalogOf(10000);
+    vector<int> ids = popularIds(10000, 1 << 12, 5);
+    vector<SaleView> sales;
+    for (int id : ids) {
+        SaleView sold;
+        if (inventory.sellProduct(id, 1, sold)) sales.push_back(sold);
+        inventory.restockProduct(id, 1);
+    }
+    Reciept receipt;
+    receipt.reserve(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        for (int64_t i = 0; i < state.range(0); ++i) receipt.addItem(sales[static_cast<size_t>(i) % sales.size()]);
+        receipt.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ReceiptAddItem)->Arg(12)->Arg(60)->Arg(1000);
+
+void BM_ReceiptGetFileContent(benchmark::State& state) {
+    Inventory& inventory = catalogOf(10000);
+    vector<int> ids = popularIds(10000, static_cast<size_t>(state.range(0)), 11);
+    Reciept receipt;
+    for (int id : ids) {
+        SaleView sold;
+        if (inventory.sellProduct(id, 1, sold)) receipt.addItem(sold);
+        inventory.restockProduct(id, 1);
+    }
+    for (auto _ : state) {
+        string content = receipt.getFileContent();
+        benchmark::DoNotOptimize(content.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ReceiptGetFileContent)->Arg(12)->Arg(60)->Arg(1000);
+
+} // namespace
+
+int main(int argc, char** argv) {
+    ScreenManager::setHeadless(true);
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
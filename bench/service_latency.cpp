@@ -0,0 +1,85 @@
+/*
+ * Round-trip latency of the inventory service over loopback.
+ *
+ *   single   : one terminal, one Lookup per round trip
+ *   pipeline : `terminals` clients, each sending a basket of `depth` Sells per round trip
+ *
+ * Build: g++ -std=c++20 -O2 -pthread bench/service_latency.cpp -o service_latency
+ * Run:   ./service_latency [terminals=32] [depth=16] [event loops=4]
+ */
+#define SUPERMARKET_NO_MAIN
+#include "../main.cpp"
+
+static const int catalogSize = 10000;
+static const int rounds = 2000;
+
+static void printPercentiles(const char* label, vector<double>& micros, size_t requestsPerTrip) {
+    sort(micros.begin(), micros.end());
+    auto at = [&](double q) { return micros[min(micros.size() - 1, static_cast<size_t>(q * micros.size()))]; };
+    printf("%-9s trips=%zu requests/trip=%zu  p50=%.1fus  p99=%.1fus  p99.9=%.1fus\n", label, micros.size(),
+           requestsPerTrip, at(0.5), at(0.99), at(0.999));
+}
+
+int main(int argc, char* argv[]) {
+#ifdef __linux__
+    int terminals = argc > 1 ? atoi(argv[1]) : 32;
+    int depth = argc > 2 ? atoi(argv[2]) : 16;
+    size_t loops = argc > 3 ? strtoul(argv[3], nullptr, 10) : 4;
+
+    ConcurrentInventory store;
+    store.setEventSink(NullInventoryEvents::instance());
+    for (int id = 1; id <= catalogSize; ++id) store.insertProduct(Product{id, "Item " + to_string(id), 100, 1.99});
+    InventoryServer server(store);
+    if (!server.start(0, loops)) return 1;
+
+    {
+        InventoryClient client;
+        if (!client.connect("127.0.0.1", server.port())) return 1;
+        vector<double> micros;
+        StoreReply reply;
+        for (int i = 0; i < rounds; ++i) {
+            auto start = chrono::steady_clock::now();
+            client.call(StoreRequest{StoreOp::Lookup, 1 + i % catalogSize, 0, 0.0, 0, {}}, reply);
+            micros.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+        }
+        printPercentiles("single", micros, 1);
+    }
+
+    vector<double> all;
+    mutex allLock;
+    vector<thread> lanes;
+    auto start = chrono::steady_clock::now();
+    for (int t = 0; t < terminals; ++t) {
+        lanes.emplace_back([&, t] {
+            InventoryClient client;
+            if (!client.connect("127.0.0.1", server.port())) return;
+            vector<StoreRequest> basket(depth);
+            vector<StoreReply> replies;
+            vector<double> micros;
+            for (int round = 0; round < rounds / 4; ++round) {
+                for (int k = 0; k < depth; ++k) {
+                    int id = 1 + (t * 131 + round * depth + k) % catalogSize;
+                    basket[k] = StoreRequest{(round & 1) ? StoreOp::Restock : StoreOp::Sell, id, 1, 0.0, 0, {}};
+                }
+                auto tripStart = chrono::steady_clock::now();
+                client.call(basket, replies);
+                micros.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - tripStart).count());
+            }
+            lock_guard<mutex> guard(allLock);
+            all.insert(all.end(), micros.begin(), micros.end());
+        });
+    }
+    for (auto& lane : lanes) lane.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printPercentiles("pipeline", all, static_cast<size_t>(depth));
+    auto stats = server.stats();
+    printf("%d terminals, %zu event loops: %.0f requests/s, %.1f requests per batch\n", terminals, loops,
+           all.size() * depth / seconds, stats.batches ? double(stats.requests) / stats.batches : 0.0);
+    return 0;
+#else
+    (void)argc;
+    (void)argv;
+    printf("The inventory service needs Linux (epoll).\n");
+    return 0;
+#endif
+}
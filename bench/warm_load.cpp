@@ -0,0 +1,64 @@
+/*
+ * Restart time from a snapshot: the parallel warm load (InventorySnapshot::loadBytes
+ * into an empty inventory) against one loadProduct call per record.
+ *
+ * Build: g++ -std=c++20 -O2 -pthread bench/warm_load.cpp -o warm_load
+ * Run:   ./warm_load [products=5000000]
+ */
+#define SUPERMARKET_NO_MAIN
+#include "../main.cpp"
+
+static double millisSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 5000000;
+
+    string bytes;
+    {
+        Inventory source;
+        source.setEventSink(NullInventoryEvents::instance());
+        source.reserve(count, count * 16);
+        for (size_t i = 0; i < count; ++i) {
+            int id = static_cast<int>(i * 2654435761u % 2000000000u) + 1;
+            source.loadProduct(id, "Product " + to_string(i), static_cast<int>(i % 101), 1.0 + i % 500);
+        }
+        bytes = InventorySnapshot(source).getFileContent();
+    }
+    printf("%zu products, %.1f MiB snapshot, %u hardware threads\n", count, bytes.size() / 1048576.0,
+           thread::hardware_concurrency());
+
+    {
+        Inventory inventory;
+        inventory.setEventSink(NullInventoryEvents::instance());
+        auto result = InventorySnapshot::loadBytes(bytes, inventory);
+        auto start = chrono::steady_clock::now();
+        inventory.searchByName("Product 1", 1);
+        const WarmLoadTimings& t = result.stages;
+        printf("warm load   %8.1f ms  (parse %.1f | merge %.1f | columns %.1f | indexes %.1f) first search %.1f ms\n",
+               result.millis, t.parse, t.merge, t.columns, t.indexes, millisSince(start));
+    }
+
+    {
+        // Same records through the per-product path (what a non-empty inventory gets).
+        Inventory inventory;
+        inventory.setEventSink(NullInventoryEvents::instance());
+        auto start = chrono::steady_clock::now();
+        SnapshotHeader header;
+        memcpy(&header, bytes.data(), sizeof(header));
+        const char* records = bytes.data() + sizeof(header);
+        string_view strings(records + count * sizeof(SnapshotRecord), header.stringBytes);
+        inventory.reserve(count, strings.size());
+        for (size_t i = 0; i < count; ++i) {
+            SnapshotRecord r;
+            memcpy(&r, records + i * sizeof(r), sizeof(r));
+            inventory.loadProduct(r.id, strings.substr(r.nameOffset, r.nameLength), r.quantity, r.price);
+        }
+        double loaded = millisSince(start);
+        start = chrono::steady_clock::now();
+        inventory.searchByName("Product 1", 1);
+        printf("per product %8.1f ms  first search %.1f ms\n", loaded, millisSince(start));
+    }
+    return 0;
+}
@@ -12,17 +12,34 @@
  *   1) clearScreen() - Clears console for better readability
  *   2) pauseForUser() - Controls flow by waiting for user input
  *   3) clearInputBuffer() - Ensures clean input handling
+ *   4) setHeadless() - Turns screen clearing and pauses off (benchmarks, scripts)
  *
  * > TimeTools - Provides timestamp functionality
- *   1) now_timestamp() - Generates unique timestamps for file naming
+ *   1) now_timestamp() / timestamp() - Local time, formatted once per second per thread
+ *   2) uniqueFileName() - Timestamp plus a process-wide sequence (no same-second collisions)
+ *   3) nanos() - Monotonic nanoseconds for latency measurement
  *
  * > FileExporter - Manages file operations
  *   1) exportToFile() - Safely exports content to files with validation
+ *   2) exportBinary() - Writes binary content (snapshots)
+ *
+ * > TextWriter - Formats into a fixed buffer with to_chars, drains in large writes
+ *   1) StringWriter / StreamWriter / FileWriter - string, ostream and file targets
+ *   2) IPrintable::writeContent() streams exports without an intermediate string
+ *
+ * > MappedFile - Read-only memory-mapped view of a file (mmap / MapViewOfFile)
+ *
+ * > Parallel - forRange() splits an index range into chunks shared by a few threads;
+ *   sort() sorts chunks concurrently and merges them in rounds
  *
  * Product:
  * 1) Core data structure representing supermarket products
- * 2) toString() - Formats product info for console display
- * 3) toFileString() - Formats product info for file storage
+ * 2) toString() / writeDisplay() - Formats product info for console display
+ * 3) toFileString() / writeRecord() - Formats product info for file storage
+ * 4) LineItem - One basket line (product ID + quantity) for batch sales
+ * 5) NameTable - Interns product names into a chunk arena; a NameId stays valid after deletion
+ * 6) SaleView - Lightweight sale result (name handle instead of a string copy)
+ * 7) barcode - Optional 64-bit EAN-13 / UPC-A / EAN-8 code
  *
  * Interface (SOLID principle - Interface Segregation):
  * > IPrintable - Defines contract for printable entities
@@ -31,20 +48,137 @@
  *
  * > IInventoryOperations - Defines inventory management operations
  *   - Follows Single Responsibility Principle
+ * > ICheckoutOperations - Adds SaleView and basket sales for a single-owner inventory
+ *
+ * Product Index (Strategy Pattern):
+ * > IProductIndex - Maps a product ID to its storage slot
+ *   1) FlatHashIndex - Open-addressing hash map (default, any ID range)
+ *   2) DenseIndex - Direct vector lookup for compact ID ranges
+ *   - Every mutation resolves its product with a single lookup
+ *
+ * Barcodes:
+ * > Barcode - GTIN check digit validation
+ * > BarcodeIndex - Open-addressing barcode -> slot map for barcodes assigned at runtime
+ * > StaticBarcodeTable - Minimal perfect hash for a fixed catalog, generated with
+ *   --gen-barcode-table and compiled in with SUPERMARKET_STATIC_CATALOG (one probe per scan)
+ *
+ * Product Storage (Structure of Arrays):
+ * > ProductColumns - Contiguous id / quantity / price columns
+ *   - Stock scans and reports run linearly over a single column
+ *
+ * Stock Limits:
+ * > StockPolicy - Capacity and SHORT warning level per storage slot; FixedStockPolicy<100, 20>
+ *   (-DSUPERMARKET_FIXED_STOCK_LIMITS) or StockClassPolicy<100, 20> (16-bit class per product)
+ * > StockLimitTable - Named stock classes and per-product limits, kept in stock_limits.txt
+ *
+ * Low Stock:
+ * > LowStockQueue - Indexed min-heap of products below their warning level, updated on every stock change
+ *   - Restock queue and "restock all to N" cost O(k) in the number of short products
+ *
+ * Name Search:
+ * > NameIndex - Case-insensitive sorted (name, id) index kept up to date on insert/delete
+ *   1) findPrefix() - Binary search to the prefix range
+ *   2) findFuzzy() - Typo-tolerant search walking the sorted run as an implicit trie
+ *
+ * Inventory Events (Observer Pattern):
+ * > IInventoryEvents - Structured sink for operation results and stock warnings
+ *   1) ConsoleInventoryEvents - Default, prints the familiar console messages
+ *   2) NullInventoryEvents - Drops everything (headless runs, bulk imports)
+ *   3) RingBufferInventoryEvents - Keeps the latest events in memory
+ *   4) SalesLedger - Session totals (sales, units, revenue) across receipts
  *
  * Inventory:
  * - Implements both IInventoryOperations and IPrintable interfaces
- * - Uses std::map for efficient product lookup by ID
+ * - Reports every outcome as an InventoryEvent instead of writing to cout
+ * - Stores products in ProductColumns behind a pluggable IProductIndex
+ * - Running totals (SKUs, units, stock value, empty/short counts) kept by each mutation
+ * - Column reports: low stock, restock report
+ * - sellBatch() validates a whole basket in one pass, all-or-nothing
+ * - Per-sale temporaries come from a TransactionArena (pmr) released after each sale
+ * - Reports and exports still iterate in ID order
+ * - writePage() renders one filtered page (ID range, low stock, name prefix) from a cursor
+ * - resolveBarcode() maps a scanned barcode to its product (unique, check digit validated)
  * - Provides complete CRUD operations with validation
  * - Includes stock level warnings (empty, low stock, full)
- * - Enforces business rules (max quantity 100)
+ * - Enforces business rules (capacity and warning level from the StockPolicy, 100 and 20 by default)
+ *
+ * InventorySnapshot:
+ * - Versioned binary snapshot: fixed-size records, a string table and a barcode column
+ * - Written through IPrintable/FileExporter, loaded through MappedFile
+ * - Records the last write-ahead log sequence it contains
+ * - Restart (empty inventory) is a warm load: records parsed in parallel chunks, indexes
+ *   merged, columns filled in one allocation each, name index and restock queue sorted in
+ *   parallel; the time of each stage is reported at startup
+ *
+ * WriteAheadLog:
+ * - Journals every successful insert/delete/restock/sell (IInventoryEvents sink)
+ * - Compact checksummed binary records, group commit on a flusher thread
+ *
+ * InventoryPersistence:
+ * - Startup: load snapshot, replay newer log records, resume journaling
+ * - Save Snapshot: checkpoint, then start an empty log
+ *
+ * Replication:
+ * > ReplicationSender - Branch side (--replicate host:port --branch N); streams write-ahead
+ *   log records to headquarters in compressed, acknowledged batches, with a fresh baseline
+ *   (snapshot + log) whenever the hub cannot continue the stream
+ * > ReplicationHub - Headquarters (--hub port); one mirror inventory per branch, network-wide
+ *   stock per product and totals (also via --query host:port stock <id> | totals)
+ *
+ * CatalogImporter:
+ * - Streams CSV or exported text catalogs in 1 MiB chunks (from_chars, no per-line streams)
+ * - Reserves capacity up front, inserts silently, reports rows/s and rejected rows
+ *
+ * Restock Planning:
+ * > RestockPlanner - Daily demand per product from the sales history (exponential smoothing),
+ *   safety stock from the forecast error; suggests orders for products at their reorder point
+ *   - Days are bucketed and products forecast in parallel; the plan is applied in one batch
+ *
+ * AsyncExporter:
+ * - Export Inventory copies the columns into a recycled snapshot and returns at once
+ * - A worker thread sorts, renders and writes the file; completion via future or callback
+ * - Also writes InventoryReadView snapshots of a ConcurrentInventory, from any thread
+ *
+ * Metrics:
+ * > MeteredInventory - Decorator over ICheckoutOperations; skipped entirely with --no-metrics
+ * > InventoryMetrics - Per-operation calls, failures, allocations and HDR-style latency histograms
+ *   - Text dump and JSON from the admin menu, JSON (metrics.json) at shutdown
+ *
+ * ConcurrentInventory:
+ * - Thread-safe variant for several checkout lanes sharing one store
+ * - Shards products by ID, one mutex per shard (no global lock)
+ * - Each shard is a regular Inventory, so the stock limits still hold
+ * - execute() applies a batch of requests with one lock per touched shard
+ * - snapshot() gives reports a consistent InventoryReadView; writers only wait for the
+ *   instant of the cut, and a shard's copy is taken by the reader or its next writer
+ *
+ * Inventory Service:
+ * > InventoryServer - --serve port [--threads N]; epoll event loops on a shared port, pipelined
+ *   binary requests (insert/sell/restock/delete/lookup) batched into a ConcurrentInventory,
+ *   one log sync per batch before the replies go out
+ * > InventoryClient - Blocking client that pipelines a whole basket per round trip
+ *
+ * Pricing:
+ * > PricingEngine - Promotion rules (percent off, buy N get M free, N for a price) compiled
+ *   into flat arrays; prices a whole receipt in one lookup pass and one branch-free pass
+ *   - Money is integer cents (Cents); rules are kept in promotions.txt
  *
  * Receipt:
  * - Implements IPrintable interface
- * - Manages sales transactions and calculates totals
+ * - Manages sales transactions and calculates totals (cents, promotions applied on demand)
+ * - Lines refer to products by ID and interned name handle (no string copies)
  * - Provides formatted receipt generation
  * - Supports clearing and status checking
  *
+ * Sales History:
+ * > SalesHistory - Every exported receipt as columnar rows (day, time, product, units, cents)
+ *   partitioned by day; past days packed into frame-of-reference columns
+ *   - Revenue by day, top sellers, units per hour; kept in sales_history.dat
+ *
+ * Receipt Sessions:
+ * > ReceiptPool - Recycles cleared receipts with pre-reserved lines (bounded idle count)
+ * > ReceiptSessions - One open receipt per checkout lane, recycled after export
+ *
  * InputHandler:
  * - Centralized input validation system
  * - Type-safe input methods for different data types
@@ -54,20 +188,29 @@
  * Main Menu (Strategy Pattern):
  * - Abstract base class for role-specific menus
  * - Polymorphic menu system for different user roles
+ * - Shared paginated, filterable Show Inventory screen
  *
  * Roles (Role-Based Access Control):
  * > AdminMenu - Full system access
  *   - All inventory operations
  *   - Sales processing
  *   - Export capabilities
+ *   - Dashboard (running totals and session sales, no scans)
+ *   - Metrics (latency percentiles, allocations per call, JSON export)
+ *   - Promotions (add, replace or remove a product's rule)
+ *   - Sales Reports (revenue by day, top sellers, units per hour from the sales history)
+ *   - Stock Limits (stock classes, per-product capacity and warning level)
  *
  * > InventoryManagerMenu - Inventory-focused access
  *   - Product management
- *   - Restocking
+ *   - Restocking (single, restock queue, restock all to N, forecast restock plan)
  *   - Inventory exports
  *
  * > CashierMenu - Sales-focused access
  *   - Product sales only
+ *   - Own checkout lane (switchable), fresh receipt per customer
+ *   - Scan Barcode sells by barcode instead of a typed product ID
+ *   - Product search by name (prefix or typo-tolerant)
  *   - Receipt generation
  *   - Inventory viewing
  *
@@ -76,6 +219,8 @@
  *   - Coordinates all system components
  *   - Manages application lifecycle
  *   - Handles role-based menu routing
+ *   - Batch mode (--script file) replays typed input headless and buffered
+ *   - Optional replication to a headquarters hub (status on the dashboard)
  *
  * KEY FEATURES:
  * 1. Role-Based Access Control (RBAC) with three distinct roles
@@ -127,7 +272,7 @@
  * 5. Multi-user environment with different access levels
  *
  * TECHNICAL STACK:
- * - C++ Standard Library (iostream, string, vector, map, fstream, etc.)
+ * - C++20 Standard Library (iostream, string, vector, span, fstream, etc.)
  * - Cross-platform compatible (except system("cls") - Windows specific)
  * - No external dependencies
  *
@@ -147,17 +292,75 @@
 #include <ctime>
 #include <chrono>
 #include <sstream>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <string_view>
+#include <span>
+#include <mutex>
+#include <cstring>
+#include <thread>
+#include <condition_variable>
+#include <filesystem>
+#include <charconv>
+#include <stdexcept>
+#include <future>
+#include <deque>
+#include <memory_resource>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <optional>
+#include <utility>
+#include <variant>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <io.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#endif
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
 
 using namespace std;
 
 // --------------------------------------Tools
 class ScreenManager {
+    static inline bool headless = false;
+
 public:
+    // Headless runs (benchmarks, scripts) never clear the screen or wait for Enter.
+    static void setHeadless(bool enabled) {
+        headless = enabled;
+    }
+
+    static bool isHeadless() {
+        return headless;
+    }
+
     static void clearScreen() {
+        if (headless) return;
         system("cls"); // Windows only
     }
 
     static void pauseForUser() {
+        if (headless) return;
         cout << "\nPress Enter to continue...";
         cin.ignore(numeric_limits<streamsize>::max(), '\n');
         cin.get();
@@ -169,14 +372,104 @@ public:
     }
 };
 
+// Clock service for high-frequency callers. Local time is converted and formatted
+// once per wall-clock second per thread (no locking, no allocation), and file names
+// carry a process-wide sequence number so exports in the same second never collide.
 class TimeTools {
+    struct Second {
+        time_t at = -1;
+        tm local{};
+        char stamp[16] = {}; // YYYYmmdd_HHMMSS
+    };
+
+    static const Second& second(time_t when) {
+        thread_local Second cache;
+        if (cache.at != when) {
+#ifdef _WIN32
+            localtime_s(&cache.local, &when);
+#else
+            localtime_r(&when, &cache.local);
+#endif
+            strftime(cache.stamp, sizeof(cache.stamp), "%Y%m%d_%H%M%S", &cache.local);
+            cache.at = when;
+        }
+        return cache;
+    }
+
 public:
+    // "YYYYmmdd_HHMMSS". The view is only valid on this thread until the next call.
+    static string_view timestamp() {
+        return second(time(nullptr)).stamp;
+    }
+
     static string now_timestamp() {
-        auto t = chrono::system_clock::now();
-        time_t tt = chrono::system_clock::to_time_t(t);
-        char buf[64];
-        strftime(buf, sizeof(buf), "%Y%m%d_%H%M%S", localtime(&tt));
-        return string(buf);
+        return string(timestamp());
+    }
+
+    static tm localTime(time_t when) {
+        return second(when).local;
+    }
+
+    // Monotonic nanoseconds, for latency measurement.
+    static uint64_t nanos() {
+        return static_cast<uint64_t>(
+            chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // "<prefix><timestamp>_<sequence><extension>". The sequence only grows, and names
+    // already on disk (an earlier run in the same second) are skipped.
+    static string uniqueFileName(string_view prefix, string_view extension) {
+        static atomic<uint64_t> sequence{0};
+        while (true) {
+            char number[24];
+            snprintf(number, sizeof(number), "_%04llu", static_cast<unsigned long long>(++sequence));
+            string name;
+            name.reserve(prefix.size() + 15 + strlen(number) + extension.size());
+            name.append(prefix).append(timestamp()).append(number).append(extension);
+            error_code ec;
+            if (!filesystem::exists(name, ec)) return name;
+        }
+    }
+};
+
+// Splits [0, count) into chunks of `grain` that the calling thread and up to
+// hardware_concurrency - 1 helpers take from a shared counter, so uneven chunks
+// balance themselves. body(begin, end) must be safe to run concurrently.
+class Parallel {
+public:
+    template <typename Body>
+    static void forRange(size_t count, size_t grain, Body&& body) {
+        grain = max<size_t>(grain, 1);
+        size_t chunks = (count + grain - 1) / grain;
+        size_t helpers = min<size_t>(max(thread::hardware_concurrency(), 1u), chunks) - (chunks > 0);
+        atomic<size_t> next{0};
+        auto work = [&] {
+            for (size_t chunk; (chunk = next.fetch_add(1)) < chunks;) {
+                body(chunk * grain, min(count, (chunk + 1) * grain));
+            }
+        };
+        vector<thread> pool;
+        pool.reserve(helpers);
+        for (size_t i = 0; i < helpers; ++i) pool.emplace_back(work);
+        work();
+        for (auto& t : pool) t.join();
+    }
+
+    // Sorts runs of `grain` elements concurrently, then merges neighbouring runs in
+    // rounds (each round's merges run concurrently).
+    template <typename It, typename Less>
+    static void sort(It first, It last, Less less, size_t grain = 1 << 16) {
+        size_t count = static_cast<size_t>(last - first);
+        grain = max<size_t>(grain, 1);
+        forRange(count, grain, [&](size_t begin, size_t end) { std::sort(first + begin, first + end, less); });
+        for (size_t width = grain; width < count; width *= 2) {
+            forRange((count + 2 * width - 1) / (2 * width), 1, [&](size_t begin, size_t end) {
+                for (size_t pair = begin; pair < end; ++pair) {
+                    size_t low = pair * 2 * width, middle = min(low + width, count), high = min(low + 2 * width, count);
+                    inplace_merge(first + low, first + middle, first + high, less);
+                }
+            });
+        }
     }
 };
 
@@ -191,6 +484,193 @@ public:
         out.close();
         return true;
     }
+
+    static bool exportBinary(const string& bytes, const string& filepath) {
+        ofstream out(filepath, ios::binary | ios::trunc);
+        if (!out.is_open()) {
+            return false;
+        }
+        out.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+        out.close();
+        return static_cast<bool>(out);
+    }
+};
+
+// Formats straight into a fixed 64 KiB block and hands it on in large writes,
+// so rendering reports and receipts needs no intermediate strings or streams.
+class TextWriter {
+    static constexpr size_t capacity = 64 * 1024;
+    char block[capacity];
+    size_t used = 0;
+
+    char* reserve(size_t bytes) {
+        if (capacity - used < bytes) flush();
+        return block + used;
+    }
+
+protected:
+    virtual void drain(const char* data, size_t size) = 0;
+
+public:
+    TextWriter() = default;
+    TextWriter(const TextWriter&) = delete;
+    TextWriter& operator=(const TextWriter&) = delete;
+    // Derived writers flush in their own destructor; drain() is gone by the time this runs.
+    virtual ~TextWriter() = default;
+
+    TextWriter& operator<<(string_view text) {
+        if (text.size() > capacity - used) {
+            flush();
+            if (text.size() >= capacity) {
+                drain(text.data(), text.size());
+                return *this;
+            }
+        }
+        memcpy(block + used, text.data(), text.size());
+        used += text.size();
+        return *this;
+    }
+
+    TextWriter& operator<<(const char* text) {
+        return *this << string_view(text);
+    }
+
+    TextWriter& operator<<(char c) {
+        *reserve(1) = c;
+        ++used;
+        return *this;
+    }
+
+    template <typename T>
+        requires is_integral_v<T>
+    TextWriter& operator<<(T value) {
+        char* at = reserve(24);
+        used += static_cast<size_t>(to_chars(at, block + capacity, value).ptr - at);
+        return *this;
+    }
+
+    // Same output as an ostream's default formatting (%g, 6 significant digits).
+    TextWriter& operator<<(double value) {
+        char* at = reserve(32);
+        used += static_cast<size_t>(to_chars(at, block + capacity, value, chars_format::general, 6).ptr - at);
+        return *this;
+    }
+
+    void flush() {
+        if (used) {
+            drain(block, used);
+            used = 0;
+        }
+    }
+};
+
+class StringWriter : public TextWriter {
+    string& target;
+
+protected:
+    void drain(const char* data, size_t size) override {
+        target.append(data, size);
+    }
+
+public:
+    explicit StringWriter(string& target) : target(target) {}
+    ~StringWriter() override { flush(); }
+};
+
+class StreamWriter : public TextWriter {
+    ostream& target;
+
+protected:
+    void drain(const char* data, size_t size) override {
+        target.write(data, static_cast<streamsize>(size));
+    }
+
+public:
+    explicit StreamWriter(ostream& target) : target(target) {}
+    ~StreamWriter() override { flush(); }
+};
+
+class FileWriter : public TextWriter {
+    FILE* file = nullptr;
+    bool failed = false;
+
+protected:
+    void drain(const char* data, size_t size) override {
+        if (file && fwrite(data, 1, size, file) != size) failed = true;
+    }
+
+public:
+    explicit FileWriter(const string& filepath) : file(fopen(filepath.c_str(), "w")) {
+        // TextWriter already batches; skip the stdio buffer as well.
+        if (file) setvbuf(file, nullptr, _IONBF, 0);
+    }
+
+    ~FileWriter() override { finish(); }
+
+    bool isOpen() const { return file != nullptr; }
+
+    bool finish() {
+        if (!file) return false;
+        flush();
+        failed |= fclose(file) != 0;
+        file = nullptr;
+        return !failed;
+    }
+};
+
+// Read-only memory mapping of a whole file (RAII).
+class MappedFile {
+    const char* base = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+public:
+    explicit MappedFile(const string& filepath) {
+#ifdef _WIN32
+        file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) return;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) return;
+        base = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (base) length = static_cast<size_t>(size.QuadPart);
+#else
+        int fd = open(filepath.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                base = static_cast<const char*>(mapped);
+                length = static_cast<size_t>(info.st_size);
+                madvise(mapped, length, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (base) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (base) munmap(const_cast<char*>(base), length);
+#endif
+    }
+
+    bool isOpen() const { return base != nullptr; }
+    const char* data() const { return base; }
+    size_t size() const { return length; }
 };
 
 // --------------------------------------Product
@@ -199,28 +679,184 @@ struct Product {
     string name;
     int quantity{};
     double price{};
+    uint64_t barcode{}; // EAN-13 / UPC-A / EAN-8, 0 = none
+
+    static constexpr size_t kMaxNameLength = 1024; // longer names are rejected (one WAL record each)
+
+    static void writeDisplay(TextWriter& out, int id, string_view name, int quantity, double price) {
+        out << "ID: " << id << " | Name: " << name
+            << " | Qty: " << quantity << " | Price: " << price;
+    }
+
+    static void writeRecord(TextWriter& out, int id, string_view name, int quantity, double price) {
+        out << id << ' ' << name << ' ' << quantity << ' ' << price;
+    }
 
     string toString() const {
-        stringstream ss;
-        ss << "ID: " << id << " | Name: " << name
-           << " | Qty: " << quantity << " | Price: " << price;
-        return ss.str();
+        string text;
+        {
+            StringWriter out(text);
+            writeDisplay(out, id, name, quantity, price);
+        }
+        return text;
     }
 
     string toFileString() const {
-        stringstream ss;
-        ss << id << " " << name << " " << quantity << " " << price;
-        return ss.str();
+        string text;
+        {
+            StringWriter out(text);
+            writeRecord(out, id, name, quantity, price);
+        }
+        return text;
+    }
+};
+
+struct LineItem {
+    int id{};
+    int quantity{};
+};
+
+using NameId = uint32_t;
+
+// Append-only interning table: every distinct name is stored once and gets a NameId
+// that stays valid for the table's lifetime, even after the product is deleted.
+// Characters live in an arena of chunks that are never reallocated, so growing the
+// table never copies the names already stored.
+class NameTable {
+    struct Entry {
+        uint32_t chunk;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    static constexpr size_t kFirstChunk = 256;
+    static constexpr size_t kMaxChunk = 1 << 20;
+
+    vector<string> chunks; // each filled only up to the capacity it was created with
+    vector<Entry> entries;
+    vector<uint32_t> buckets; // NameId + 1, 0 = empty
+    size_t mask = 0;
+    size_t used = 0;
+
+    void rehash(size_t capacity) {
+        buckets.assign(capacity, 0);
+        mask = capacity - 1;
+        for (NameId id = 0; id < entries.size(); ++id) {
+            size_t i = hashOf(view(id)) & mask;
+            while (buckets[i]) i = (i + 1) & mask;
+            buckets[i] = id + 1;
+        }
+    }
+
+    void addChunk(size_t atLeast) {
+        size_t size = chunks.empty() ? kFirstChunk : min(chunks.back().capacity() * 2, kMaxChunk);
+        chunks.emplace_back();
+        chunks.back().reserve(max(size, atLeast));
+    }
+
+    Entry store(string_view text) {
+        if (chunks.empty() || chunks.back().size() + text.size() > chunks.back().capacity()) addChunk(text.size());
+        string& chunk = chunks.back();
+        Entry e{static_cast<uint32_t>(chunks.size() - 1), static_cast<uint32_t>(chunk.size()),
+                static_cast<uint32_t>(text.size())};
+        chunk.append(text);
+        used += text.size();
+        return e;
+    }
+
+public:
+    NameTable() { rehash(64); }
+
+    static uint64_t hashOf(string_view text) {
+        uint64_t hash = 1469598103934665603ull;
+        for (char c : text) hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+        return hash;
+    }
+
+    NameId intern(string_view text) {
+        return intern(text, hashOf(text));
+    }
+
+    // hash must be hashOf(text); bulk loaders compute it ahead, off this thread.
+    NameId intern(string_view text, uint64_t hash) {
+        if ((entries.size() + 1) * 4 > buckets.size() * 3) rehash(buckets.size() * 2);
+        size_t i = hash & mask;
+        for (; buckets[i]; i = (i + 1) & mask) {
+            if (view(buckets[i] - 1) == text) return buckets[i] - 1;
+        }
+        NameId id = static_cast<NameId>(entries.size());
+        entries.push_back(store(text));
+        buckets[i] = id + 1;
+        return id;
+    }
+
+    string_view view(NameId id) const {
+        const Entry& e = entries[id];
+        return string_view(chunks[e.chunk].data() + e.offset, e.length);
+    }
+
+    // bytes is an estimate of the characters to come; it sizes the next chunk.
+    void reserve(size_t count, size_t bytes) {
+        entries.reserve(count);
+        if (bytes > 0 && (chunks.empty() || chunks.back().capacity() - chunks.back().size() < bytes)) addChunk(bytes);
+        size_t capacity = buckets.size();
+        while (count * 4 > capacity * 3) capacity *= 2;
+        if (capacity != buckets.size()) rehash(capacity);
+    }
+
+    size_t size() const { return entries.size(); }
+    size_t bytes() const { return used; }
+
+    // Forgets every name; keeps the first chunk and the buckets for reuse.
+    void clear() {
+        if (chunks.size() > 1) chunks.resize(1);
+        if (!chunks.empty()) chunks.front().clear();
+        entries.clear();
+        used = 0;
+        fill(buckets.begin(), buckets.end(), 0);
     }
 };
 
+// What a sale hands back: no copy of the name, just its handle in the inventory's NameTable.
+struct SaleView {
+    int id{};
+    NameId name{};
+    const NameTable* names = nullptr;
+    int quantity{};     // quantity sold
+    int remaining{};    // stock left afterwards
+    double price{};
+
+    string_view nameText() const { return names->view(name); }
+};
+
 // --------------------------------------Interface (SOLID)
 class IPrintable {
 public:
     virtual ~IPrintable() = default;
     virtual string getFileContent() const = 0;
+
+    // Streaming form of getFileContent(); override it to render without building a string.
+    virtual void writeContent(TextWriter& out) const {
+        out << getFileContent();
+    }
+
     virtual bool printToFile(const string& filepath) const {
-        return FileExporter::exportToFile(getFileContent(), filepath);
+        FileWriter out(filepath);
+        if (!out.isOpen()) {
+            return false;
+        }
+        writeContent(out);
+        return out.finish();
+    }
+
+protected:
+    string renderContent() const {
+        string content;
+        {
+            StringWriter out(content);
+            writeContent(out);
+        }
+        return content;
     }
 };
 
@@ -234,142 +870,5987 @@ public:
     virtual void showInventory() const = 0;
 };
 
-// --------------------------------------Inventory
-class Inventory : public IInventoryOperations, public IPrintable {
-    map<int, Product> products;
+class Reciept;
 
+// Checkout paths of a single-owner inventory: sales that hand back views into its
+// own storage, which a sharded inventory cannot offer safely.
+class ICheckoutOperations : public IInventoryOperations {
 public:
-    bool insertProduct(const Product& p) override {
-        if (products.count(p.id)) {
-            cout << " X Product already exists.\n";
-            return false;
-        }
-        if (p.quantity > 100) {
-            cout << " X Quantity cannot exceed 100.\n";
-            return false;
-        }
-        products[p.id] = p;
-        cout << "Product inserted successfully. :D \n";
-        return true;
+    using IInventoryOperations::sellProduct;
+    virtual bool sellProduct(int id, int amount, SaleView& outSold) = 0;
+    virtual bool sellBatch(span<const LineItem> basket, Reciept& receipt) = 0;
+};
+
+// --------------------------------------Pricing
+// Money at the till is integer cents. Catalog prices are doubles and are rounded
+// once, when a sale reaches the receipt.
+using Cents = int64_t;
+
+inline Cents toCents(double amount) {
+    return llround(amount * 100.0);
+}
+
+// Writes cents as a decimal amount, e.g. -150 -> "-1.50".
+inline void writeMoney(TextWriter& out, Cents amount) {
+    if (amount < 0) {
+        out << '-';
+        amount = -amount;
     }
+    out << amount / 100 << '.' << static_cast<char>('0' + amount % 100 / 10) << static_cast<char>('0' + amount % 10);
+}
 
-    bool deleteProduct(int id) override {
-        if (products.erase(id)) {
-            cout << " Product deleted successfully. :D \n";
-            return true;
+enum class PromotionKind : uint8_t { PercentOff, BuyGetFree, Bundle };
+
+// One rule per product, in the form the operator enters it.
+struct Promotion {
+    int productId = 0;
+    PromotionKind kind = PromotionKind::PercentOff;
+    int percent = 0;      // PercentOff: 1..100
+    int buy = 0;          // BuyGetFree: pay for `buy`...
+    int free = 0;         // ...and get `free` more
+    int bundleSize = 0;   // Bundle: `bundleSize` units for bundlePrice
+    Cents bundlePrice = 0;
+
+    bool valid() const {
+        switch (kind) {
+            case PromotionKind::PercentOff: return percent >= 1 && percent <= 100;
+            case PromotionKind::BuyGetFree: return buy >= 1 && free >= 1;
+            case PromotionKind::Bundle: return bundleSize >= 2 && bundlePrice >= 0;
         }
-        cout << " X Product not found.\n";
         return false;
     }
 
-    bool restockProduct(int id, int amount) override {
-        if (!products.count(id)) {
-            cout << " X Product not found.\n";
-            return false;
+    void writeDescription(TextWriter& out) const {
+        switch (kind) {
+            case PromotionKind::PercentOff: out << percent << "% off"; break;
+            case PromotionKind::BuyGetFree: out << "buy " << buy << " get " << free << " free"; break;
+            case PromotionKind::Bundle:
+                out << bundleSize << " for ";
+                writeMoney(out, bundlePrice);
+                break;
         }
-        auto& prod = products[id];
-        if (prod.quantity + amount > 100) {
-            cout << " X Cannot restock beyond 100.\n";
-            return false;
+    }
+};
+
+// A receipt's lines merged per product and priced; kept by the receipt so
+// repricing reuses the buffers.
+struct PricedBasket {
+    vector<int> ids;
+    vector<int64_t> quantities;
+    vector<Cents> unitPrices;
+    vector<uint32_t> rules;
+    // Each entry's rule, gathered so the arithmetic pass reads contiguous columns.
+    vector<int64_t> groupSizes;
+    vector<int64_t> freeUnits;
+    vector<Cents> groupPrices;
+    vector<int64_t> basisPoints;
+    vector<Cents> discounts;
+    vector<uint32_t> lines; // first receipt line of each entry
+    Cents gross = 0;
+    Cents discount = 0;
+
+    size_t size() const { return ids.size(); }
+    Cents total() const { return gross - discount; }
+
+    void clear() {
+        ids.clear();
+        quantities.clear();
+        unitPrices.clear();
+        rules.clear();
+        groupSizes.clear();
+        freeUnits.clear();
+        groupPrices.clear();
+        basisPoints.clear();
+        discounts.clear();
+        lines.clear();
+        gross = 0;
+        discount = 0;
+    }
+};
+
+/*
+ * Promotion rules compiled into flat arrays. Every kind reduces to the same
+ * per-line formula over (group size, free units per group, bundle price,
+ * percent in basis points), with neutral values for the parts a rule does not
+ * use, and slot 0 is a rule that changes nothing. Pricing a basket is one
+ * lookup pass that gathers each entry's rule, then one branch-free arithmetic
+ * pass over contiguous columns, whatever the rule mix. Divisions go through
+ * double so the pass has no integer division and GCC/Clang vectorize it at -O3.
+ */
+class PricingEngine {
+    vector<Promotion> rules; // sorted by product id
+
+    vector<int> ruleIds;         // compiled slot s + 1 belongs to ruleIds[s]
+    vector<int64_t> groupSize;   // units per group (1 for percent off)
+    vector<int64_t> freeUnits;   // free units per group
+    vector<Cents> groupPrice;    // bundle price, or kNoBundle
+    vector<int64_t> basisPoints; // percent off * 100
+    uint64_t compiled = 0;       // bumped on every change, so receipts know to reprice
+
+    static constexpr Cents kNoBundle = numeric_limits<Cents>::max() / 4;
+
+    void compile() {
+        ++compiled;
+        size_t n = rules.size() + 1;
+        ruleIds.clear();
+        groupSize.assign(n, 1);
+        freeUnits.assign(n, 0);
+        groupPrice.assign(n, kNoBundle);
+        basisPoints.assign(n, 0);
+        for (size_t s = 1; s < n; ++s) {
+            const Promotion& rule = rules[s - 1];
+            ruleIds.push_back(rule.productId);
+            switch (rule.kind) {
+                case PromotionKind::PercentOff: basisPoints[s] = rule.percent * 100; break;
+                case PromotionKind::BuyGetFree:
+                    groupSize[s] = rule.buy + rule.free;
+                    freeUnits[s] = rule.free;
+                    break;
+                case PromotionKind::Bundle:
+                    groupSize[s] = rule.bundleSize;
+                    groupPrice[s] = rule.bundlePrice;
+                    break;
+            }
         }
-        prod.quantity += amount;
-        cout << "Restocked successfully.:D Current quantity: " << prod.quantity << "\n";
+    }
+
+    vector<Promotion>::iterator position(int productId) {
+        return lower_bound(rules.begin(), rules.end(), productId,
+                           [](const Promotion& rule, int id) { return rule.productId < id; });
+    }
+
+public:
+    PricingEngine() { compile(); }
+
+    static constexpr const char* defaultPath = "promotions.txt";
+
+    // Adds the product's rule, replacing any earlier one.
+    bool set(const Promotion& rule) {
+        if (!rule.valid()) return false;
+        auto it = position(rule.productId);
+        if (it != rules.end() && it->productId == rule.productId) *it = rule;
+        else rules.insert(it, rule);
+        compile();
         return true;
     }
 
-    bool sellProduct(int id, int amount, Product& outTaken) override {
-        if (!products.count(id)) {
-            cout << " X Product not found.\n";
-            return false;
+    bool remove(int productId) {
+        auto it = position(productId);
+        if (it == rules.end() || it->productId != productId) return false;
+        rules.erase(it);
+        compile();
+        return true;
+    }
+
+    const Promotion* find(int productId) const {
+        uint32_t slot = ruleFor(productId);
+        return slot ? &rules[slot - 1] : nullptr;
+    }
+
+    span<const Promotion> promotions() const { return rules; }
+    size_t size() const { return rules.size(); }
+    uint64_t revision() const { return compiled; }
+
+    // Compiled slot of the product's rule, 0 when it has none.
+    uint32_t ruleFor(int productId) const {
+        auto it = lower_bound(ruleIds.begin(), ruleIds.end(), productId);
+        if (it == ruleIds.end() || *it != productId) return 0;
+        return static_cast<uint32_t>(it - ruleIds.begin()) + 1;
+    }
+
+    // Fills rules, discounts and totals for the basket's ids, quantities and unit prices.
+    void price(PricedBasket& basket) const {
+        size_t n = basket.size();
+        basket.rules.resize(n);
+        basket.groupSizes.resize(n);
+        basket.freeUnits.resize(n);
+        basket.groupPrices.resize(n);
+        basket.basisPoints.resize(n);
+        basket.discounts.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t r = ruleFor(basket.ids[i]);
+            basket.rules[i] = r;
+            basket.groupSizes[i] = groupSize[r];
+            basket.freeUnits[i] = freeUnits[r];
+            basket.groupPrices[i] = groupPrice[r];
+            basket.basisPoints[i] = basisPoints[r];
         }
-        auto& prod = products[id];
-        if (prod.quantity < amount) {
-            cout << " X Not enough stock.\n";
-            return false;
+
+        const int64_t* quantity = basket.quantities.data();
+        const Cents* unit = basket.unitPrices.data();
+        const int64_t* group = basket.groupSizes.data();
+        const int64_t* free = basket.freeUnits.data();
+        const Cents* bundle = basket.groupPrices.data();
+        const int64_t* basis = basket.basisPoints.data();
+        Cents* discount = basket.discounts.data();
+        Cents gross = 0;
+        Cents saved = 0;
+        for (size_t i = 0; i < n; ++i) {
+            Cents q = quantity[i];
+            Cents p = unit[i];
+            // Exact floor(q / group) and floor(x / 10000) for any realistic basket
+            // (operands far below 2^50).
+            Cents groups = static_cast<Cents>((static_cast<double>(q) + 0.5) / static_cast<double>(group[i]));
+            Cents freeOff = groups * free[i] * p;
+            Cents bundleOff = groups * max<Cents>(group[i] * p - bundle[i], 0);
+            Cents percentOff = static_cast<Cents>(static_cast<double>(q * p * basis[i]) / 10000.0);
+            Cents off = freeOff + bundleOff + percentOff;
+            discount[i] = off;
+            gross += q * p;
+            saved += off;
         }
-        prod.quantity -= amount;
-        outTaken = prod;
-        outTaken.quantity = amount;
+        basket.gross = gross;
+        basket.discount = saved;
+    }
 
-        //Warnings!!
-        if (prod.quantity == 0)
-            cout << " X Product '" << prod.name << "' is now EMPTY!\n";
-        else if (prod.quantity < 20)
-            cout << "  Product '" << prod.name << "' is SHORT and needs refilling!\n";
-        else if (prod.quantity == 100)
-            cout << " Product '" << prod.name << "' is FULL. :D\n";
+    // One rule per line: "percent <id> <percent>", "buy <id> <buy> <free>" or
+    // "bundle <id> <size> <cents>".
+    bool saveFile(const string& filepath) const {
+        FileWriter out(filepath);
+        if (!out.isOpen()) return false;
+        for (auto& rule : rules) {
+            switch (rule.kind) {
+                case PromotionKind::PercentOff: out << "percent " << rule.productId << ' ' << rule.percent; break;
+                case PromotionKind::BuyGetFree:
+                    out << "buy " << rule.productId << ' ' << rule.buy << ' ' << rule.free;
+                    break;
+                case PromotionKind::Bundle:
+                    out << "bundle " << rule.productId << ' ' << rule.bundleSize << ' ' << rule.bundlePrice;
+                    break;
+            }
+            out << '\n';
+        }
+        return out.finish();
+    }
 
-        cout << "Sale successful. :D\n";
-        return true;
+    // Returns how many rules were read; malformed lines are skipped.
+    size_t loadFile(const string& filepath) {
+        ifstream in(filepath);
+        size_t loaded = 0;
+        string kind;
+        while (in >> kind) {
+            Promotion rule;
+            if (kind == "percent") {
+                rule.kind = PromotionKind::PercentOff;
+                in >> rule.productId >> rule.percent;
+            } else if (kind == "buy") {
+                rule.kind = PromotionKind::BuyGetFree;
+                in >> rule.productId >> rule.buy >> rule.free;
+            } else if (kind == "bundle") {
+                rule.kind = PromotionKind::Bundle;
+                in >> rule.productId >> rule.bundleSize >> rule.bundlePrice;
+            }
+            if (!in) {
+                if (in.eof()) break;
+                in.clear();
+            } else if (set(rule)) {
+                ++loaded;
+            }
+            in.ignore(numeric_limits<streamsize>::max(), '\n');
+        }
+        return loaded;
+    }
+};
+
+// --------------------------------------Reciept
+// One receipt line: refers to the product by ID and to its name by an interned handle.
+struct ReceiptLine {
+    const NameTable* names;
+    NameId name;
+    int productId;
+    int quantity;
+    Cents price;
+
+    string_view nameText() const { return names->view(name); }
+};
+
+class Reciept : public IPrintable {
+    vector<ReceiptLine> soldItems;
+    NameTable localNames; // names added by string rather than from an inventory sale
+    const PricingEngine* pricing = nullptr;
+
+    // Priced on demand, so a sale only appends its line.
+    mutable PricedBasket priced;
+    mutable vector<uint32_t> order;
+    mutable uint64_t pricedRevision = 0;
+    mutable bool pricedValid = false;
+
+    void reprice() const {
+        static const PricingEngine noPromotions;
+        const PricingEngine& engine = pricing ? *pricing : noPromotions;
+        if (pricedValid && pricedRevision == engine.revision()) return;
+
+        // Merge lines of the same product so multi-buys count across separate scans.
+        order.resize(soldItems.size());
+        for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+        sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            const ReceiptLine& x = soldItems[a];
+            const ReceiptLine& y = soldItems[b];
+            return x.productId != y.productId ? x.productId < y.productId : x.price < y.price;
+        });
+        priced.clear();
+        for (uint32_t i : order) {
+            const ReceiptLine& line = soldItems[i];
+            if (!priced.ids.empty() && line.productId != 0 && priced.ids.back() == line.productId &&
+                priced.unitPrices.back() == line.price) {
+                priced.quantities.back() += line.quantity;
+                continue;
+            }
+            priced.ids.push_back(line.productId);
+            priced.quantities.push_back(line.quantity);
+            priced.unitPrices.push_back(line.price);
+            priced.lines.push_back(i);
+        }
+        engine.price(priced);
+        pricedRevision = engine.revision();
+        pricedValid = true;
+    }
+
+public:
+    Reciept() = default;
+    // Lines point into localNames, so a receipt stays where it was created.
+    Reciept(const Reciept&) = delete;
+    Reciept& operator=(const Reciept&) = delete;
+
+    void addItem(const string& name, int qty, double price) {
+        soldItems.push_back(ReceiptLine{&localNames, localNames.intern(name), 0, qty, toCents(price)});
+        pricedValid = false;
+    }
+
+    void addItem(const SaleView& sale) {
+        soldItems.push_back(ReceiptLine{sale.names, sale.name, sale.id, sale.quantity, toCents(sale.price)});
+        pricedValid = false;
+    }
+
+    // Promotions to price with; null sells at list price.
+    void setPricing(const PricingEngine* engine) {
+        pricing = engine;
+        pricedValid = false;
+    }
+
+    void reserve(size_t lines) {
+        soldItems.reserve(lines);
+    }
+
+    size_t capacity() const {
+        return soldItems.capacity();
+    }
+
+    const vector<ReceiptLine>& lines() const {
+        return soldItems;
+    }
+
+    const PricedBasket& basket() const {
+        reprice();
+        return priced;
+    }
+
+    Cents totalCents() const {
+        return basket().total();
+    }
+
+    Cents savingsCents() const {
+        return basket().discount;
+    }
+
+    double getTotal() const {
+        return totalCents() / 100.0;
+    }
+
+    string getFileContent() const override {
+        return renderContent();
+    }
+
+    void writeContent(TextWriter& content) const override {
+        const PricedBasket& priced = basket();
+        content << "===== RECEIPT =====\n";
+        content << "Timestamp: " << TimeTools::timestamp() << "\n";
+        content << "-------------------\n";
+        for (auto& p : soldItems) {
+            content << p.nameText() << " x" << p.quantity << " @ ";
+            writeMoney(content, p.price);
+            content << " = ";
+            writeMoney(content, p.quantity * p.price);
+            content << "\n";
+        }
+        content << "-------------------\n";
+        if (priced.discount > 0) {
+            for (size_t i = 0; i < priced.size(); ++i) {
+                if (priced.discounts[i] == 0) continue;
+                content << soldItems[priced.lines[i]].nameText() << " (";
+                if (const Promotion* rule = pricing->find(priced.ids[i])) rule->writeDescription(content);
+                content << "): ";
+                writeMoney(content, -priced.discounts[i]);
+                content << "\n";
+            }
+            content << "Subtotal: ";
+            writeMoney(content, priced.gross);
+            content << "\nSavings: ";
+            writeMoney(content, priced.discount);
+            content << "\n";
+        }
+        content << "Total: ";
+        writeMoney(content, priced.total());
+        content << "\n";
+        content << "===================\n";
+    }
+
+    void clear() {
+        soldItems.clear();
+        localNames.clear();
+        priced.clear();
+        pricedValid = false;
+    }
+
+    bool isEmpty() const {
+        return soldItems.empty();
+    }
+};
+
+// --------------------------------------Sales History
+/*
+ * Every exported receipt, one row per product: local calendar day, seconds since
+ * local midnight, product ID, units and the amount paid in cents (promotions
+ * applied). Rows are partitioned by day. The current day is kept as plain
+ * 64-bit columns; older days are sealed into frame-of-reference columns that
+ * store value - minimum in the narrowest of 1, 2 or 4 bytes, so every query is a
+ * tight loop over small integers (widened on the fly) that the compiler vectorizes.
+ * Rows are also appended to sales_history.dat as fixed 24-byte records.
+ */
+class PackedColumn {
+    int64_t base = 0; // added to every stored value
+    variant<vector<int64_t>, vector<uint8_t>, vector<uint16_t>, vector<uint32_t>> values;
+
+public:
+    bool sealed() const { return values.index() != 0; }
+
+    size_t size() const {
+        return visit([](auto& v) { return v.size(); }, values);
+    }
+
+    size_t byteSize() const {
+        return visit([](auto& v) { return v.size() * sizeof(v[0]); }, values);
+    }
+
+    int64_t at(size_t i) const {
+        return visit([&](auto& v) { return base + static_cast<int64_t>(v[i]); }, values);
+    }
+
+    // Open columns only.
+    void append(int64_t value) {
+        get<0>(values).push_back(value);
+    }
+
+    void seal() {
+        if (sealed()) return;
+        vector<int64_t> raw = move(get<0>(values));
+        int64_t low = raw.empty() ? 0 : *min_element(raw.begin(), raw.end());
+        int64_t high = raw.empty() ? 0 : *max_element(raw.begin(), raw.end());
+        uint64_t range = static_cast<uint64_t>(high) - static_cast<uint64_t>(low);
+        auto pack = [&](auto narrow) {
+            using T = decltype(narrow);
+            vector<T> out(raw.size());
+            for (size_t i = 0; i < raw.size(); ++i) out[i] = static_cast<T>(raw[i] - low);
+            base = low;
+            values = move(out);
+        };
+        if (range <= 0xFF) pack(uint8_t{});
+        else if (range <= 0xFFFF) pack(uint16_t{});
+        else if (range <= 0xFFFFFFFFu) pack(uint32_t{});
+        else values = move(raw); // too wide to narrow
+    }
+
+    // Back to plain values, for a late row into a sealed day.
+    void unseal() {
+        if (!sealed()) return;
+        vector<int64_t> raw(size());
+        decode(0, raw.size(), raw.data());
+        base = 0;
+        values = move(raw);
+    }
+
+    // Widens rows [from, from + count) into out.
+    void decode(size_t from, size_t count, int64_t* out) const {
+        visit([&](auto& v) {
+            for (size_t i = 0; i < count; ++i) out[i] = base + static_cast<int64_t>(v[from + i]);
+        }, values);
+    }
+
+    int64_t sum() const {
+        return visit([&](auto& v) {
+            int64_t total = 0;
+            for (auto value : v) total += static_cast<int64_t>(value);
+            return total + base * static_cast<int64_t>(v.size());
+        }, values);
+    }
+
+    // Appends the row numbers holding `value` to out (branch-free selection vector).
+    void select(int64_t value, vector<uint32_t>& out) const {
+        visit([&](auto& v) {
+            size_t start = out.size();
+            out.resize(start + v.size());
+            uint32_t* rows = out.data() + start;
+            size_t found = 0;
+            int64_t target = value - base;
+            for (size_t i = 0; i < v.size(); ++i) {
+                rows[found] = static_cast<uint32_t>(i);
+                found += static_cast<int64_t>(v[i]) == target;
+            }
+            out.resize(start + found);
+        }, values);
+    }
+};
+
+struct SalesPartition {
+    int32_t day = 0; // days since 1970-01-01, local calendar
+    PackedColumn seconds, ids, units, cents;
+
+    size_t size() const { return ids.size(); }
+
+    void seal() {
+        for (PackedColumn* column : {&seconds, &ids, &units, &cents}) column->seal();
+    }
+
+    void unseal() {
+        for (PackedColumn* column : {&seconds, &ids, &units, &cents}) column->unseal();
+    }
+};
+
+struct DaySales {
+    int32_t day;
+    long long units;
+    Cents revenue;
+};
+
+struct ProductSales {
+    int id;
+    long long units;
+    Cents revenue;
+};
+
+class SalesHistory {
+    struct Record {
+        int32_t day;
+        uint32_t seconds;
+        int32_t id;
+        int32_t units;
+        int64_t cents;
+    };
+    static_assert(sizeof(Record) == 24);
+    static constexpr char magic[8] = {'S', 'M', 'H', 'I', 'S', 'T', '1', '\0'};
+    static constexpr size_t kChunk = 4096; // rows widened per step of a scan
+
+    vector<SalesPartition> partitions; // ascending day, only the last can be open
+    string path;
+    size_t rowCount = 0;
+
+    SalesPartition& partitionFor(int32_t day) {
+        if (partitions.empty() || partitions.back().day < day) {
+            if (!partitions.empty()) partitions.back().seal();
+            partitions.push_back(SalesPartition{});
+            partitions.back().day = day;
+            return partitions.back();
+        }
+        // The clock went back: reopen the day the row belongs to.
+        auto it = lower_bound(partitions.begin(), partitions.end(), day,
+                              [](const SalesPartition& p, int32_t d) { return p.day < d; });
+        if (it == partitions.end() || it->day != day) {
+            it = partitions.insert(it, SalesPartition{});
+            it->day = day;
+        }
+        it->unseal();
+        return *it;
+    }
+
+    void add(const Record& r) {
+        SalesPartition& partition = partitionFor(r.day);
+        partition.seconds.append(r.seconds);
+        partition.ids.append(r.id);
+        partition.units.append(r.units);
+        partition.cents.append(r.cents);
+        ++rowCount;
+    }
+
+    static Record localRecord(time_t when) {
+        tm local = TimeTools::localTime(when);
+        Record r{};
+        chrono::year_month_day date{chrono::year(local.tm_year + 1900), chrono::month(local.tm_mon + 1),
+                                    chrono::day(local.tm_mday)};
+        r.day = static_cast<int32_t>(chrono::sys_days(date).time_since_epoch().count());
+        r.seconds = static_cast<uint32_t>(local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec);
+        return r;
+    }
+
+public:
+    static constexpr const char* defaultPath = "sales_history.dat";
+
+    // Loads the file (dropping a torn last record) and appends to it from then on.
+    // Without a path the history lives in memory only.
+    bool open(const string& filepath) {
+        path = filepath;
+        ifstream in(path, ios::binary);
+        if (!in) return FileExporter::exportBinary(string(magic, sizeof(magic)), path);
+        string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        in.close();
+        if (bytes.size() < sizeof(magic) || memcmp(bytes.data(), magic, sizeof(magic)) != 0) {
+            path.clear();
+            return false;
+        }
+        size_t rows = (bytes.size() - sizeof(magic)) / sizeof(Record);
+        for (size_t i = 0; i < rows; ++i) {
+            Record r;
+            memcpy(&r, bytes.data() + sizeof(magic) + i * sizeof(Record), sizeof(r));
+            add(r);
+        }
+        size_t valid = sizeof(magic) + rows * sizeof(Record);
+        if (valid != bytes.size()) {
+            error_code ec;
+            filesystem::resize_file(path, valid, ec);
+        }
+        return true;
+    }
+
+    // Records the priced lines of a finished receipt; lines without a product ID are skipped.
+    bool record(const PricedBasket& basket, time_t when = time(nullptr)) {
+        Record base = localRecord(when);
+        string bytes;
+        for (size_t i = 0; i < basket.size(); ++i) {
+            if (basket.ids[i] == 0) continue;
+            Record r = base;
+            r.id = basket.ids[i];
+            r.units = static_cast<int32_t>(basket.quantities[i]);
+            r.cents = basket.quantities[i] * basket.unitPrices[i] - basket.discounts[i];
+            add(r);
+            bytes.append(reinterpret_cast<const char*>(&r), sizeof(r));
+        }
+        if (path.empty() || bytes.empty()) return true;
+        ofstream out(path, ios::binary | ios::app);
+        out.write(bytes.data(), static_cast<streamsize>(bytes.size()));
+        return static_cast<bool>(out);
+    }
+
+    static int32_t today() {
+        return localRecord(time(nullptr)).day;
+    }
+
+    static void writeDay(TextWriter& out, int32_t day) {
+        chrono::year_month_day date{chrono::sys_days(chrono::days(day))};
+        char text[16];
+        snprintf(text, sizeof(text), "%04d-%02u-%02u", static_cast<int>(date.year()),
+                 static_cast<unsigned>(date.month()), static_cast<unsigned>(date.day()));
+        out << text;
+    }
+
+    size_t rows() const { return rowCount; }
+    size_t partitionCount() const { return partitions.size(); }
+
+    // Earliest day with sales (today when there are none).
+    int32_t firstDay() const {
+        return partitions.empty() ? today() : partitions.front().day;
+    }
+
+    // Partitions with fromDay <= day <= toDay, oldest first.
+    template <typename F>
+    void forDays(int32_t fromDay, int32_t toDay, F&& visit) const {
+        auto it = lower_bound(partitions.begin(), partitions.end(), fromDay,
+                              [](const SalesPartition& p, int32_t d) { return p.day < d; });
+        for (; it != partitions.end() && it->day <= toDay; ++it) visit(*it);
+    }
+
+    // Bytes held by the columns (sealed days are packed).
+    size_t columnBytes() const {
+        size_t total = 0;
+        for (auto& p : partitions) {
+            total += p.seconds.byteSize() + p.ids.byteSize() + p.units.byteSize() + p.cents.byteSize();
+        }
+        return total;
+    }
+
+    vector<DaySales> revenueByDay(int32_t fromDay, int32_t toDay) const {
+        vector<DaySales> days;
+        forDays(fromDay, toDay, [&](const SalesPartition& p) {
+            days.push_back(DaySales{p.day, p.units.sum(), p.cents.sum()});
+        });
+        return days;
+    }
+
+    // Best sellers by units, then revenue.
+    vector<ProductSales> topSellers(int32_t fromDay, int32_t toDay, size_t limit) const {
+        unordered_map<int, ProductSales> totals;
+        array<int64_t, kChunk> ids, units, cents;
+        forDays(fromDay, toDay, [&](const SalesPartition& p) {
+            for (size_t from = 0; from < p.size(); from += kChunk) {
+                size_t count = min(kChunk, p.size() - from);
+                p.ids.decode(from, count, ids.data());
+                p.units.decode(from, count, units.data());
+                p.cents.decode(from, count, cents.data());
+                for (size_t i = 0; i < count; ++i) {
+                    auto [it, fresh] = totals.try_emplace(static_cast<int>(ids[i]), ProductSales{static_cast<int>(ids[i]), 0, 0});
+                    it->second.units += units[i];
+                    it->second.revenue += cents[i];
+                }
+            }
+        });
+        vector<ProductSales> ranked;
+        ranked.reserve(totals.size());
+        for (auto& [id, sales] : totals) ranked.push_back(sales);
+        auto better = [](const ProductSales& a, const ProductSales& b) {
+            if (a.units != b.units) return a.units > b.units;
+            if (a.revenue != b.revenue) return a.revenue > b.revenue;
+            return a.id < b.id;
+        };
+        size_t keep = min(limit, ranked.size());
+        partial_sort(ranked.begin(), ranked.begin() + static_cast<ptrdiff_t>(keep), ranked.end(), better);
+        ranked.resize(keep);
+        return ranked;
+    }
+
+    // Units of one product by hour of day (local time), summed over the days.
+    array<long long, 24> unitsPerHour(int productId, int32_t fromDay, int32_t toDay) const {
+        array<long long, 24> hours{};
+        vector<uint32_t> rows;
+        forDays(fromDay, toDay, [&](const SalesPartition& p) {
+            rows.clear();
+            p.ids.select(productId, rows);
+            for (uint32_t row : rows) hours[min<int64_t>(p.seconds.at(row) / 3600, 23)] += p.units.at(row);
+        });
+        return hours;
+    }
+};
+
+// --------------------------------------Receipt Sessions
+// Recycles receipts: each comes back cleared with its line capacity intact, so
+// steady-state checkout does not allocate. Idle receipts are capped, and one that
+// grew far past the reserve is dropped instead of kept.
+class ReceiptPool {
+    mutex lock;
+    vector<unique_ptr<Reciept>> idle;
+    size_t reservedLines;
+    size_t maxIdle;
+
+public:
+    explicit ReceiptPool(size_t reservedLines = 64, size_t maxIdle = 16)
+        : reservedLines(reservedLines), maxIdle(maxIdle) {}
+
+    unique_ptr<Reciept> acquire() {
+        {
+            lock_guard<mutex> guard(lock);
+            if (!idle.empty()) {
+                unique_ptr<Reciept> receipt = move(idle.back());
+                idle.pop_back();
+                return receipt;
+            }
+        }
+        auto receipt = make_unique<Reciept>();
+        receipt->reserve(reservedLines);
+        return receipt;
+    }
+
+    void release(unique_ptr<Reciept> receipt) {
+        if (!receipt || receipt->capacity() > reservedLines * 16) return;
+        receipt->clear();
+        lock_guard<mutex> guard(lock);
+        if (idle.size() < maxIdle) idle.push_back(move(receipt));
+    }
+
+    size_t idleCount() {
+        lock_guard<mutex> guard(lock);
+        return idle.size();
+    }
+};
+
+// One open receipt per checkout lane, taken from the pool on the first sale and
+// returned to it once exported.
+class ReceiptSessions {
+    ReceiptPool& pool;
+    const PricingEngine* pricing;
+    SalesHistory* history;
+    vector<unique_ptr<Reciept>> lanes;
+
+public:
+    static constexpr int kMaxLanes = 16;
+
+    explicit ReceiptSessions(ReceiptPool& pool, const PricingEngine* pricing = nullptr,
+                             SalesHistory* history = nullptr)
+        : pool(pool), pricing(pricing), history(history), lanes(kMaxLanes) {}
+
+    static bool validLane(int lane) {
+        return lane >= 0 && lane < kMaxLanes;
+    }
+
+    Reciept& current(int lane) {
+        auto& receipt = lanes[lane];
+        if (!receipt) {
+            receipt = pool.acquire();
+            receipt->setPricing(pricing);
+        }
+        return *receipt;
+    }
+
+    bool hasItems(int lane) const {
+        return lanes[lane] && !lanes[lane]->isEmpty();
+    }
+
+    // Writes the lane's receipt and, on success, records it in the sales history
+    // and recycles it for the next customer.
+    bool finish(int lane, const string& filepath) {
+        if (!hasItems(lane) || !lanes[lane]->printToFile(filepath)) return false;
+        if (history && !history->record(lanes[lane]->basket())) {
+            cerr << " X Failed to append to the sales history.\n";
+        }
+        pool.release(move(lanes[lane]));
+        return true;
+    }
+
+    size_t openCount() const {
+        size_t open = 0;
+        for (auto& receipt : lanes) open += receipt && !receipt->isEmpty();
+        return open;
+    }
+};
+
+// --------------------------------------Product Index
+class IProductIndex {
+public:
+    static constexpr uint32_t npos = numeric_limits<uint32_t>::max();
+
+    virtual ~IProductIndex() = default;
+    virtual bool accepts(int) const { return true; }
+    virtual uint32_t find(int id) const = 0;
+    // Returns npos when the id was inserted, otherwise the slot already holding it
+    // (or, for an id the index does not accept, some other value than npos).
+    virtual uint32_t tryInsert(int id, uint32_t slot) = 0;
+    // Returns the slot the id was mapped to, or npos when it was not present.
+    virtual uint32_t erase(int id) = 0;
+    virtual void assign(int id, uint32_t slot) = 0;
+    virtual void forEachOrdered(const function<void(int, uint32_t)>& visit) const = 0;
+    // Visits ids >= firstId in ascending order until visit returns false.
+    virtual void forEachOrderedFrom(int firstId, const function<bool(int, uint32_t)>& visit) const = 0;
+    virtual void reserve(size_t count) = 0;
+    virtual void clear() = 0;
+};
+
+class FlatHashIndex : public IProductIndex {
+    struct Entry {
+        int key;
+        uint32_t slot = npos;
+    };
+
+    vector<Entry> entries;
+    size_t count = 0;
+    size_t mask = 0;
+
+    // Sorted key cache for paging. Small edits are applied in place; after
+    // kOrderEditLimit of them the cache is rebuilt on the next ordered walk.
+    static constexpr size_t kOrderEditLimit = 1024;
+    mutable vector<int> orderedKeys;
+    mutable bool orderValid = false;
+    mutable size_t orderEdits = 0;
+
+    void orderInserted(int key) {
+        if (!orderValid) return;
+        if (orderedKeys.empty() || key > orderedKeys.back()) {
+            orderedKeys.push_back(key);
+        } else if (++orderEdits > kOrderEditLimit) {
+            orderValid = false;
+        } else {
+            orderedKeys.insert(lower_bound(orderedKeys.begin(), orderedKeys.end(), key), key);
+        }
+    }
+
+    void orderErased(int key) {
+        if (!orderValid) return;
+        if (!orderedKeys.empty() && key == orderedKeys.back()) {
+            orderedKeys.pop_back();
+        } else if (++orderEdits > kOrderEditLimit) {
+            orderValid = false;
+        } else {
+            orderedKeys.erase(lower_bound(orderedKeys.begin(), orderedKeys.end(), key));
+        }
+    }
+
+    size_t bucketOf(int key) const {
+        return (static_cast<uint32_t>(key) * 0x9E3779B97F4A7C15ull >> 32) & mask;
+    }
+
+    void rehash(size_t capacity) {
+        vector<Entry> old = move(entries);
+        entries.assign(capacity, Entry{});
+        mask = capacity - 1;
+        for (auto& e : old) {
+            if (e.slot == npos) continue;
+            size_t i = bucketOf(e.key);
+            while (entries[i].slot != npos) i = (i + 1) & mask;
+            entries[i] = e;
+        }
+    }
+
+public:
+    FlatHashIndex() { rehash(16); }
+
+    uint32_t find(int id) const override {
+        for (size_t i = bucketOf(id); entries[i].slot != npos; i = (i + 1) & mask) {
+            if (entries[i].key == id) return entries[i].slot;
+        }
+        return npos;
+    }
+
+    uint32_t tryInsert(int id, uint32_t slot) override {
+        if ((count + 1) * 4 > entries.size() * 3) rehash(entries.size() * 2);
+        size_t i = bucketOf(id);
+        for (; entries[i].slot != npos; i = (i + 1) & mask) {
+            if (entries[i].key == id) return entries[i].slot;
+        }
+        entries[i] = Entry{id, slot};
+        ++count;
+        orderInserted(id);
+        return npos;
+    }
+
+    uint32_t erase(int id) override {
+        size_t i = bucketOf(id);
+        for (; entries[i].slot != npos; i = (i + 1) & mask) {
+            if (entries[i].key == id) break;
+        }
+        uint32_t removed = entries[i].slot;
+        if (removed == npos) return npos;
+
+        // Backward-shift deletion keeps probe chains intact without tombstones.
+        for (size_t j = (i + 1) & mask; entries[j].slot != npos; j = (j + 1) & mask) {
+            size_t home = bucketOf(entries[j].key);
+            bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+            if (movable) {
+                entries[i] = entries[j];
+                i = j;
+            }
+        }
+        entries[i].slot = npos;
+        --count;
+        orderErased(id);
+        return removed;
+    }
+
+    void assign(int id, uint32_t slot) override {
+        for (size_t i = bucketOf(id); entries[i].slot != npos; i = (i + 1) & mask) {
+            if (entries[i].key == id) {
+                entries[i].slot = slot;
+                return;
+            }
+        }
+    }
+
+    void forEachOrdered(const function<void(int, uint32_t)>& visit) const override {
+        vector<Entry> sorted;
+        sorted.reserve(count);
+        for (auto& e : entries) {
+            if (e.slot != npos) sorted.push_back(e);
+        }
+        sort(sorted.begin(), sorted.end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+        for (auto& e : sorted) visit(e.key, e.slot);
+    }
+
+    void forEachOrderedFrom(int firstId, const function<bool(int, uint32_t)>& visit) const override {
+        if (!orderValid) {
+            orderedKeys.clear();
+            orderedKeys.reserve(count);
+            for (auto& e : entries) {
+                if (e.slot != npos) orderedKeys.push_back(e.key);
+            }
+            sort(orderedKeys.begin(), orderedKeys.end());
+            orderValid = true;
+            orderEdits = 0;
+        }
+        for (auto it = lower_bound(orderedKeys.begin(), orderedKeys.end(), firstId); it != orderedKeys.end(); ++it) {
+            if (!visit(*it, find(*it))) break;
+        }
+    }
+
+    void reserve(size_t wanted) override {
+        size_t capacity = entries.size();
+        while (wanted * 4 > capacity * 3) capacity *= 2;
+        if (capacity != entries.size()) rehash(capacity);
+    }
+
+    void clear() override {
+        entries.assign(16, Entry{});
+        mask = 15;
+        count = 0;
+        orderedKeys.clear();
+        orderValid = false;
+    }
+};
+
+class DenseIndex : public IProductIndex {
+    vector<uint32_t> slots;
+    int maxId;
+
+public:
+    explicit DenseIndex(int maxId = 1 << 24) : maxId(maxId) {}
+
+    bool accepts(int id) const override {
+        return id >= 0 && id <= maxId;
+    }
+
+    uint32_t find(int id) const override {
+        if (id < 0 || static_cast<size_t>(id) >= slots.size()) return npos;
+        return slots[id];
+    }
+
+    uint32_t tryInsert(int id, uint32_t slot) override {
+        if (!accepts(id)) return slot; // not inserted; Inventory checks accepts() first anyway
+        if (static_cast<size_t>(id) >= slots.size()) {
+            slots.resize(max(static_cast<size_t>(id) + 1, slots.size() * 2), npos);
+        }
+        if (slots[id] != npos) return slots[id];
+        slots[id] = slot;
+        return npos;
+    }
+
+    uint32_t erase(int id) override {
+        if (id < 0 || static_cast<size_t>(id) >= slots.size()) return npos;
+        uint32_t removed = slots[id];
+        slots[id] = npos;
+        return removed;
+    }
+
+    void assign(int id, uint32_t slot) override {
+        slots[id] = slot;
+    }
+
+    void forEachOrdered(const function<void(int, uint32_t)>& visit) const override {
+        for (size_t id = 0; id < slots.size(); ++id) {
+            if (slots[id] != npos) visit(static_cast<int>(id), slots[id]);
+        }
+    }
+
+    void forEachOrderedFrom(int firstId, const function<bool(int, uint32_t)>& visit) const override {
+        for (size_t id = static_cast<size_t>(max(firstId, 0)); id < slots.size(); ++id) {
+            if (slots[id] != npos && !visit(static_cast<int>(id), slots[id])) break;
+        }
+    }
+
+    void reserve(size_t count) override {
+        slots.reserve(min(count, static_cast<size_t>(maxId) + 1));
+    }
+
+    void clear() override {
+        slots.clear();
+    }
+};
+
+// Dense suits catalogs whose IDs run from 1 to about their count (--dense-ids);
+// it rejects IDs above DenseIndex's maxId.
+enum class IndexMode { FlatHash, Dense };
+
+inline unique_ptr<IProductIndex> makeProductIndex(IndexMode mode) {
+    if (mode == IndexMode::Dense) return make_unique<DenseIndex>();
+    return make_unique<FlatHashIndex>();
+}
+
+// --------------------------------------Barcodes
+// GTIN codes (EAN-13, UPC-A, EAN-8) held as integers. The check digit is weighted
+// from the right, so the leading zeros an integer drops do not change it.
+struct Barcode {
+    static constexpr uint64_t kMax = 99'999'999'999'999ull; // 14 digits
+
+    static constexpr bool valid(uint64_t code) {
+        if (code == 0 || code > kMax) return false;
+        int sum = 0;
+        int weight = 3;
+        for (uint64_t rest = code / 10; rest != 0; rest /= 10) {
+            sum += static_cast<int>(rest % 10) * weight;
+            weight = 4 - weight;
+        }
+        return (10 - sum % 10) % 10 == static_cast<int>(code % 10);
+    }
+
+    static constexpr uint64_t mix(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDull;
+        x ^= x >> 33;
+        x *= 0xC4CEB9FE1A85EC53ull;
+        x ^= x >> 33;
+        return x;
+    }
+};
+
+static_assert(Barcode::valid(4006381333931ull) && Barcode::valid(36000291452ull) && Barcode::valid(96385074ull) &&
+              !Barcode::valid(4006381333932ull), "GTIN check digit");
+
+// Barcode -> storage slot for barcodes assigned at runtime. Same open addressing
+// as FlatHashIndex; 0 marks an empty bucket since it is never a valid barcode.
+class BarcodeIndex {
+    struct Entry {
+        uint64_t code = 0;
+        uint32_t slot = 0;
+    };
+
+    vector<Entry> entries;
+    size_t count = 0;
+    size_t mask = 0;
+
+    size_t bucketOf(uint64_t code) const {
+        return Barcode::mix(code) & mask;
+    }
+
+    void rehash(size_t capacity) {
+        vector<Entry> old = move(entries);
+        entries.assign(capacity, Entry{});
+        mask = capacity - 1;
+        for (auto& e : old) {
+            if (e.code == 0) continue;
+            size_t i = bucketOf(e.code);
+            while (entries[i].code != 0) i = (i + 1) & mask;
+            entries[i] = e;
+        }
+    }
+
+public:
+    static constexpr uint32_t npos = IProductIndex::npos;
+
+    BarcodeIndex() { rehash(16); }
+
+    uint32_t find(uint64_t code) const {
+        for (size_t i = bucketOf(code); entries[i].code != 0; i = (i + 1) & mask) {
+            if (entries[i].code == code) return entries[i].slot;
+        }
+        return npos;
+    }
+
+    // Returns false when the barcode is already mapped.
+    bool insert(uint64_t code, uint32_t slot) {
+        if ((count + 1) * 4 > entries.size() * 3) rehash(entries.size() * 2);
+        size_t i = bucketOf(code);
+        for (; entries[i].code != 0; i = (i + 1) & mask) {
+            if (entries[i].code == code) return false;
+        }
+        entries[i] = Entry{code, slot};
+        ++count;
+        return true;
+    }
+
+    void erase(uint64_t code) {
+        size_t i = bucketOf(code);
+        for (; entries[i].code != 0; i = (i + 1) & mask) {
+            if (entries[i].code == code) break;
+        }
+        if (entries[i].code == 0) return;
+
+        for (size_t j = (i + 1) & mask; entries[j].code != 0; j = (j + 1) & mask) {
+            size_t home = bucketOf(entries[j].code);
+            bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+            if (movable) {
+                entries[i] = entries[j];
+                i = j;
+            }
+        }
+        entries[i] = Entry{};
+        --count;
+    }
+
+    void assign(uint64_t code, uint32_t slot) {
+        for (size_t i = bucketOf(code); entries[i].code != 0; i = (i + 1) & mask) {
+            if (entries[i].code == code) {
+                entries[i].slot = slot;
+                return;
+            }
+        }
+    }
+
+    void reserve(size_t wanted) {
+        size_t capacity = entries.size();
+        while (wanted * 4 > capacity * 3) capacity *= 2;
+        if (capacity != entries.size()) rehash(capacity);
+    }
+
+    size_t size() const { return count; }
+
+    void clear() {
+        entries.assign(16, Entry{});
+        mask = 15;
+        count = 0;
+    }
+};
+
+/*
+ * Minimal perfect hash over a fixed catalog (hash and displace). Each barcode
+ * hashes to a bucket, the bucket's seed sends it to its own slot, and there are
+ * exactly as many slots as barcodes: a scan is one probe and one compare.
+ * build() searches the seeds, largest buckets first; writeSource() emits them as a
+ * constexpr table that SUPERMARKET_STATIC_CATALOG compiles in (--gen-barcode-table).
+ */
+class StaticBarcodeTable {
+public:
+    struct Entry {
+        uint64_t code;
+        int id;
+    };
+
+    struct Built {
+        vector<uint32_t> seeds;
+        vector<Entry> entries;
+    };
+
+    static constexpr size_t kBucketSize = 4; // average barcodes per seed
+
+private:
+    span<const uint32_t> seeds;
+    span<const Entry> entries;
+
+    static constexpr size_t bucketOf(uint64_t code, size_t buckets) {
+        return Barcode::mix(code) % buckets;
+    }
+
+    static constexpr size_t slotOf(uint64_t code, uint32_t seed, size_t slots) {
+        return Barcode::mix(code ^ Barcode::mix(seed + 1ull)) % slots;
+    }
+
+public:
+    constexpr StaticBarcodeTable() = default;
+    constexpr StaticBarcodeTable(span<const uint32_t> seeds, span<const Entry> entries)
+        : seeds(seeds), entries(entries) {}
+
+    constexpr bool find(uint64_t code, int& outId) const {
+        if (entries.empty()) return false;
+        const Entry& e = entries[slotOf(code, seeds[bucketOf(code, seeds.size())], entries.size())];
+        if (e.code != code) return false;
+        outId = e.id;
+        return true;
+    }
+
+    constexpr size_t size() const { return entries.size(); }
+    constexpr bool empty() const { return entries.empty(); }
+
+    // Fails on an empty or invalid barcode, or one listed twice.
+    static bool build(span<const Entry> keys, Built& out) {
+        size_t n = keys.size();
+        size_t bucketCount = max<size_t>((n + kBucketSize - 1) / kBucketSize, 1);
+        out.seeds.assign(bucketCount, 0);
+        out.entries.assign(n, Entry{0, 0});
+
+        // Group keys by bucket (counting sort), then place the largest buckets first.
+        vector<uint64_t> codes;
+        codes.reserve(n);
+        for (auto& key : keys) {
+            if (!Barcode::valid(key.code)) return false;
+            codes.push_back(key.code);
+        }
+        sort(codes.begin(), codes.end());
+        if (adjacent_find(codes.begin(), codes.end()) != codes.end()) return false;
+
+        vector<uint32_t> starts(bucketCount + 1, 0);
+        for (auto& key : keys) ++starts[bucketOf(key.code, bucketCount) + 1];
+        for (size_t b = 0; b < bucketCount; ++b) starts[b + 1] += starts[b];
+        vector<uint32_t> members(n);
+        vector<uint32_t> fill(starts.begin(), starts.end() - 1);
+        for (uint32_t k = 0; k < n; ++k) members[fill[bucketOf(keys[k].code, bucketCount)]++] = k;
+
+        vector<uint32_t> order(bucketCount);
+        for (uint32_t b = 0; b < bucketCount; ++b) order[b] = b;
+        stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return starts[a + 1] - starts[a] > starts[b + 1] - starts[b];
+        });
+
+        vector<bool> taken(n, false);
+        vector<size_t> trial;
+        for (uint32_t b : order) {
+            span<const uint32_t> bucket(members.data() + starts[b], starts[b + 1] - starts[b]);
+            if (bucket.empty()) break;
+            for (uint32_t seed = 0;; ++seed) {
+                // The last free slots take about n tries to hit; this bound is never reached in practice.
+                if (seed > 64 * n + 1024) return false;
+                trial.clear();
+                for (uint32_t k : bucket) {
+                    size_t slot = slotOf(keys[k].code, seed, n);
+                    if (taken[slot] || std::find(trial.begin(), trial.end(), slot) != trial.end()) break;
+                    trial.push_back(slot);
+                }
+                if (trial.size() != bucket.size()) continue;
+                for (size_t i = 0; i < bucket.size(); ++i) {
+                    taken[trial[i]] = true;
+                    out.entries[trial[i]] = keys[bucket[i]];
+                }
+                out.seeds[b] = seed;
+                break;
+            }
+        }
+        return true;
+    }
+
+    // C++ source for SUPERMARKET_STATIC_CATALOG; `table` must hold at least one barcode.
+    static void writeSource(TextWriter& out, const Built& table, string_view catalog) {
+        out << "// Generated by supermarket --gen-barcode-table from " << catalog << "; do not edit.\n";
+        out << "// " << table.entries.size() << " barcodes, " << table.seeds.size() << " seeds.\n";
+        out << "inline constexpr uint32_t kStaticCatalogSeeds[] = {";
+        for (size_t i = 0; i < table.seeds.size(); ++i) {
+            out << (i % 16 == 0 ? "\n    " : " ") << table.seeds[i] << ',';
+        }
+        out << "\n};\n\ninline constexpr StaticBarcodeTable::Entry kStaticCatalogEntries[] = {";
+        for (size_t i = 0; i < table.entries.size(); ++i) {
+            out << (i % 4 == 0 ? "\n    " : " ") << '{' << table.entries[i].code << "ull, "
+                << table.entries[i].id << "},";
+        }
+        out << "\n};\n\ninline constexpr StaticBarcodeTable kStaticCatalog{kStaticCatalogSeeds, kStaticCatalogEntries};\n";
+        const Entry& probe = table.entries.front();
+        out << "static_assert([] { int id = 0; return kStaticCatalog.find(" << probe.code << "ull, id) && id == "
+            << probe.id << "; }(), \"static catalog lookup\");\n";
+    }
+};
+
+#ifdef SUPERMARKET_STATIC_CATALOG
+#include SUPERMARKET_STATIC_CATALOG
+#else
+inline constexpr StaticBarcodeTable kStaticCatalog{};
+#endif
+
+// --------------------------------------Inventory Events
+enum class InventoryStatus {
+    Ok,
+    NotFound,
+    AlreadyExists,
+    InvalidId,
+    InvalidQuantity,
+    QuantityTooHigh,
+    CapacityExceeded,
+    NotEnoughStock,
+    EmptyBasket,
+    InvalidBarcode,
+    DuplicateBarcode,
+    NameTooLong
+};
+
+// BasketLine is emitted once per product of a successful SellBatch, before the summary event.
+enum class InventoryEventType { Insert, Delete, Restock, Sell, SellBatch, BasketLine, StockEmpty, StockShort, StockFull };
+
+struct InventoryEvent {
+    InventoryEventType type;
+    InventoryStatus status = InventoryStatus::Ok;
+    int id = 0;
+    int amount = 0;     // quantity moved, or basket line count for SellBatch
+    int stock = 0;      // stock level after the operation
+    string_view name;   // only valid for the duration of onEvent()
+    double price = 0.0;
+    uint64_t barcode = 0; // Insert only
+    int capacity = 0;     // QuantityTooHigh and CapacityExceeded only
+};
+
+class IInventoryEvents {
+public:
+    virtual ~IInventoryEvents() = default;
+    virtual void onEvent(const InventoryEvent& e) = 0;
+};
+
+// Default sink: reproduces the console messages of the interactive app.
+class ConsoleInventoryEvents : public IInventoryEvents {
+public:
+    static ConsoleInventoryEvents& instance() {
+        static ConsoleInventoryEvents sink;
+        return sink;
+    }
+
+    void onEvent(const InventoryEvent& e) override {
+        using S = InventoryStatus;
+        switch (e.type) {
+            case InventoryEventType::StockEmpty:
+                cout << " X Product '" << e.name << "' is now EMPTY!\n";
+                return;
+            case InventoryEventType::StockShort:
+                cout << "  Product '" << e.name << "' is SHORT and needs refilling!\n";
+                return;
+            case InventoryEventType::StockFull:
+                cout << " Product '" << e.name << "' is FULL. :D\n";
+                return;
+            case InventoryEventType::BasketLine:
+                return;
+            default:
+                break;
+        }
+
+        if (e.status == S::Ok) {
+            switch (e.type) {
+                case InventoryEventType::Insert: cout << "Product inserted successfully. :D \n"; break;
+                case InventoryEventType::Delete: cout << " Product deleted successfully. :D \n"; break;
+                case InventoryEventType::Restock:
+                    cout << "Restocked successfully.:D Current quantity: " << e.stock << "\n";
+                    break;
+                case InventoryEventType::Sell: cout << "Sale successful. :D\n"; break;
+                case InventoryEventType::SellBatch: cout << "Basket sold: " << e.amount << " line(s). :D\n"; break;
+                default: break;
+            }
+            return;
+        }
+
+        bool batch = e.type == InventoryEventType::SellBatch;
+        switch (e.status) {
+            case S::NotFound:
+                if (batch) cout << " X Product not found: ID " << e.id << ".\n";
+                else cout << " X Product not found.\n";
+                break;
+            case S::AlreadyExists: cout << " X Product already exists.\n"; break;
+            case S::InvalidId: cout << " X Product ID is out of range.\n"; break;
+            case S::InvalidQuantity: cout << " X Invalid quantity for product ID " << e.id << ".\n"; break;
+            case S::QuantityTooHigh: cout << " X Quantity cannot exceed " << e.capacity << ".\n"; break;
+            case S::CapacityExceeded: cout << " X Cannot restock beyond " << e.capacity << ".\n"; break;
+            case S::NotEnoughStock:
+                if (batch)
+                    cout << " X Not enough stock for '" << e.name << "' (requested "
+                         << e.amount << ", available " << e.stock << ").\n";
+                else
+                    cout << " X Not enough stock.\n";
+                break;
+            case S::EmptyBasket: cout << " X Basket is empty.\n"; break;
+            case S::InvalidBarcode: cout << " X Invalid barcode (check digit does not match).\n"; break;
+            case S::DuplicateBarcode: cout << " X Barcode already belongs to another product.\n"; break;
+            case S::NameTooLong:
+                cout << " X Name cannot be longer than " << Product::kMaxNameLength << " characters.\n";
+                break;
+            default: break;
+        }
+    }
+};
+
+class NullInventoryEvents : public IInventoryEvents {
+public:
+    static NullInventoryEvents& instance() {
+        static NullInventoryEvents sink;
+        return sink;
+    }
+
+    void onEvent(const InventoryEvent&) override {}
+};
+
+// Forwards every event to two sinks, e.g. the console and the write-ahead log.
+class TeeInventoryEvents : public IInventoryEvents {
+    IInventoryEvents& first;
+    IInventoryEvents& second;
+
+public:
+    TeeInventoryEvents(IInventoryEvents& first, IInventoryEvents& second) : first(first), second(second) {}
+
+    void onEvent(const InventoryEvent& e) override {
+        first.onEvent(e);
+        second.onEvent(e);
+    }
+};
+
+// Remembers how the last operation ended (warnings aside) and passes every event on;
+// the inventory service answers each request with it.
+class OutcomeInventoryEvents : public IInventoryEvents {
+    IInventoryEvents* next = &NullInventoryEvents::instance();
+
+public:
+    InventoryStatus status = InventoryStatus::Ok;
+    int stock = 0;
+
+    void forwardTo(IInventoryEvents& sink) { next = &sink; }
+
+    void onEvent(const InventoryEvent& e) override {
+        using T = InventoryEventType;
+        if (e.type != T::StockEmpty && e.type != T::StockShort && e.type != T::StockFull) {
+            status = e.status;
+            stock = e.stock;
+        }
+        next->onEvent(e);
+    }
+};
+
+// Keeps the most recent events in memory; names are dropped since they do not outlive the call.
+class RingBufferInventoryEvents : public IInventoryEvents {
+    vector<InventoryEvent> ring;
+    size_t written = 0;
+
+public:
+    explicit RingBufferInventoryEvents(size_t capacity = 1024) : ring(max<size_t>(capacity, 1)) {}
+
+    void onEvent(const InventoryEvent& e) override {
+        InventoryEvent& slot = ring[written % ring.size()];
+        slot = e;
+        slot.name = {};
+        ++written;
+    }
+
+    // Oldest first.
+    vector<InventoryEvent> recent() const {
+        vector<InventoryEvent> result;
+        size_t count = min(written, ring.size());
+        result.reserve(count);
+        for (size_t i = written - count; i < written; ++i) {
+            result.push_back(ring[i % ring.size()]);
+        }
+        return result;
+    }
+
+    size_t totalEvents() const { return written; }
+
+    void clear() { written = 0; }
+};
+
+// Session sales ledger: sums every successful sale across receipts since startup.
+class SalesLedger : public IInventoryEvents {
+    size_t transactions = 0; // single sales plus baskets
+    long long units = 0;
+    Cents revenue = 0;
+    chrono::system_clock::time_point started = chrono::system_clock::now();
+
+public:
+    void onEvent(const InventoryEvent& e) override {
+        if (e.status != InventoryStatus::Ok) return;
+        switch (e.type) {
+            case InventoryEventType::Sell:
+                ++transactions;
+                units += e.amount;
+                break;
+            case InventoryEventType::SellBatch: ++transactions; break;
+            case InventoryEventType::BasketLine: units += e.amount; break;
+            default: break;
+        }
+    }
+
+    // Revenue is booked per finished receipt, after promotions, so it matches the
+    // receipt and the sales history.
+    void recordReceipt(Cents total) { revenue += total; }
+
+    size_t transactionCount() const { return transactions; }
+    long long unitsSold() const { return units; }
+    Cents totalRevenue() const { return revenue; }
+    chrono::system_clock::time_point startedAt() const { return started; }
+};
+
+// --------------------------------------Product Storage
+class ProductColumns {
+public:
+    vector<int> ids;
+    vector<int> quantities;
+    vector<double> prices;
+    vector<NameId> names;
+    vector<uint64_t> barcodes;
+    NameTable nameTable;
+    // Pages of kPageRows slots written since the last clearTouched(); a page past
+    // the end counts as touched. Lets snapshots copy only the pages that changed.
+    static constexpr size_t kPageRows = 4096;
+    vector<bool> touched;
+
+    size_t size() const { return ids.size(); }
+    bool empty() const { return ids.empty(); }
+
+    size_t pageCount() const { return (ids.size() + kPageRows - 1) / kPageRows; }
+
+    void touch(size_t slot) {
+        size_t page = slot / kPageRows;
+        if (page < touched.size()) touched[page] = true;
+    }
+
+    bool pageTouched(size_t page) const { return page >= touched.size() || touched[page]; }
+
+    void clearTouched() { touched.assign(pageCount(), false); }
+
+    uint32_t append(const Product& p) {
+        return append(p.id, p.name, p.quantity, p.price, p.barcode);
+    }
+
+    uint32_t append(int id, string_view name, int quantity, double price, uint64_t barcode = 0) {
+        ids.push_back(id);
+        quantities.push_back(quantity);
+        prices.push_back(price);
+        names.push_back(nameTable.intern(name));
+        barcodes.push_back(barcode);
+        touch(ids.size() - 1);
+        return static_cast<uint32_t>(ids.size() - 1);
+    }
+
+    // Moves the last row into the removed slot; the caller repoints its id.
+    // The name stays interned so receipts holding its NameId remain valid.
+    void swapRemove(uint32_t slot) {
+        size_t last = ids.size() - 1;
+        touch(slot);
+        touch(last);
+        ids[slot] = ids[last];
+        quantities[slot] = quantities[last];
+        prices[slot] = prices[last];
+        names[slot] = names[last];
+        barcodes[slot] = barcodes[last];
+        ids.pop_back();
+        quantities.pop_back();
+        prices.pop_back();
+        names.pop_back();
+        barcodes.pop_back();
+    }
+
+    string_view name(uint32_t slot) const {
+        return nameTable.view(names[slot]);
+    }
+
+    Product row(uint32_t slot) const {
+        Product p;
+        p.id = ids[slot];
+        p.name = string(name(slot));
+        p.quantity = quantities[slot];
+        p.price = prices[slot];
+        p.barcode = barcodes[slot];
+        return p;
+    }
+
+    void reserve(size_t count, size_t nameBytes = 0) {
+        ids.reserve(count);
+        quantities.reserve(count);
+        prices.reserve(count);
+        names.reserve(count);
+        barcodes.reserve(count);
+        nameTable.reserve(count, nameBytes);
+    }
+
+    void clear() {
+        ids.clear();
+        quantities.clear();
+        prices.clear();
+        names.clear();
+        barcodes.clear();
+        touched.clear();
+    }
+};
+
+// --------------------------------------Name Search
+// Secondary index over product names for cashier lookup: (name, id) pairs sorted
+// case-insensitively, read through the inventory's NameTable (8 bytes per product).
+// Inserts land in a small unsorted tail that is merged in before it grows past
+// kPendingLimit; deletes leave a tombstone that the next merge drops.
+// The sorted run doubles as an implicit trie: every prefix is a contiguous range,
+// so typo-tolerant search walks it depth-first with one Levenshtein row per level.
+class NameIndex {
+    struct Entry {
+        NameId name; // high bit set = deleted
+        int id;
+    };
+
+    static constexpr NameId kDead = 1u << 31;
+    static constexpr size_t kPendingLimit = 1024;
+
+    const NameTable* names;
+    mutable vector<Entry> sorted;
+    mutable vector<Entry> pending;
+    mutable size_t dead = 0;
+
+    static char fold(char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    static int compareFolded(string_view a, string_view b) {
+        size_t n = min(a.size(), b.size());
+        for (size_t i = 0; i < n; ++i) {
+            char x = fold(a[i]), y = fold(b[i]);
+            if (x != y) return static_cast<unsigned char>(x) < static_cast<unsigned char>(y) ? -1 : 1;
+        }
+        return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+    }
+
+    string_view text(const Entry& e) const {
+        return names->view(e.name & ~kDead);
+    }
+
+    bool less(const Entry& a, const Entry& b) const {
+        int c = compareFolded(text(a), text(b));
+        return c != 0 ? c < 0 : a.id < b.id;
+    }
+
+    // Folds the pending tail (and drops tombstones) so lookups can binary search.
+    void settle() const {
+        if (pending.empty() && dead == 0) return;
+        auto byName = [this](const Entry& a, const Entry& b) { return less(a, b); };
+        if (dead) {
+            sorted.erase(remove_if(sorted.begin(), sorted.end(),
+                                   [](const Entry& e) { return (e.name & kDead) != 0; }),
+                         sorted.end());
+            dead = 0;
+        }
+        sort(pending.begin(), pending.end(), byName);
+        size_t middle = sorted.size();
+        sorted.insert(sorted.end(), pending.begin(), pending.end());
+        inplace_merge(sorted.begin(), sorted.begin() + middle, sorted.end(), byName);
+        pending.clear();
+    }
+
+    void settleIfLarge() const {
+        if (pending.size() > kPendingLimit || dead * 4 > sorted.size()) settle();
+    }
+
+    // Bounded edit distance for the short unsorted tail.
+    static int editDistance(string_view a, string_view b, int limit, vector<int>& row) {
+        row.resize(b.size() + 1);
+        for (size_t j = 0; j <= b.size(); ++j) row[j] = static_cast<int>(j);
+        for (size_t i = 1; i <= a.size(); ++i) {
+            int diagonal = row[0], best = row[0] = static_cast<int>(i);
+            for (size_t j = 1; j <= b.size(); ++j) {
+                int above = row[j];
+                row[j] = min({row[j] + 1, row[j - 1] + 1, diagonal + (fold(a[i - 1]) != fold(b[j - 1]))});
+                diagonal = above;
+                best = min(best, row[j]);
+            }
+            if (best > limit) return limit + 1;
+        }
+        return row[b.size()];
+    }
+
+public:
+    struct Match {
+        int id;
+        int distance; // 0 for prefix matches
+    };
+
+    explicit NameIndex(const NameTable& table) : names(&table) {}
+
+    static bool startsWithFolded(string_view text, string_view prefix) {
+        if (text.size() < prefix.size()) return false;
+        for (size_t i = 0; i < prefix.size(); ++i) {
+            if (fold(text[i]) != fold(prefix[i])) return false;
+        }
+        return true;
+    }
+
+    void insert(int id, NameId name) {
+        pending.push_back(Entry{name, id});
+        // Bulk loads merge geometrically; lookups settle anything past kPendingLimit.
+        if (pending.size() > max(kPendingLimit, sorted.size())) settle();
+    }
+
+    void erase(int id, NameId name) {
+        settleIfLarge();
+        Entry key{name, id};
+        auto it = lower_bound(sorted.begin(), sorted.end(), key,
+                              [this](const Entry& a, const Entry& b) { return less(a, b); });
+        for (; it != sorted.end() && it->id == id && compareFolded(text(*it), text(key)) == 0; ++it) {
+            if (!(it->name & kDead)) {
+                it->name |= kDead;
+                ++dead;
+                return;
+            }
+        }
+        for (size_t i = 0; i < pending.size(); ++i) {
+            if (pending[i].id == id) {
+                pending[i] = pending.back();
+                pending.pop_back();
+                return;
+            }
+        }
+    }
+
+    void reserve(size_t count) {
+        sorted.reserve(count);
+    }
+
+    // Fills an empty index in one parallel sort instead of repeated merges. Entries
+    // are sorted by their first 16 folded characters (zero padded, compared as two
+    // big-endian words) and only ties compare the names themselves.
+    void build(span<const int> ids, span<const NameId> nameIds) {
+        struct Keyed {
+            uint64_t high, low;
+            Entry entry;
+        };
+        vector<Keyed> keyed(ids.size());
+        Parallel::forRange(keyed.size(), 1 << 16, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                string_view name = names->view(nameIds[i]);
+                uint64_t word[2] = {0, 0};
+                for (size_t c = 0; c < 16; ++c) {
+                    uint8_t folded = c < name.size() ? static_cast<uint8_t>(fold(name[c])) : 0;
+                    word[c / 8] = word[c / 8] << 8 | folded;
+                }
+                keyed[i] = Keyed{word[0], word[1], Entry{nameIds[i], ids[i]}};
+            }
+        });
+        Parallel::sort(keyed.begin(), keyed.end(), [this](const Keyed& a, const Keyed& b) {
+            if (a.high != b.high) return a.high < b.high;
+            if (a.low != b.low) return a.low < b.low;
+            return less(a.entry, b.entry);
+        });
+        sorted.resize(keyed.size());
+        for (size_t i = 0; i < keyed.size(); ++i) sorted[i] = keyed[i].entry;
+        pending.clear();
+        dead = 0;
+    }
+
+    void clear() {
+        sorted.clear();
+        pending.clear();
+        dead = 0;
+    }
+
+    // Names starting with prefix (case-insensitive), in name order.
+    vector<Match> findPrefix(string_view prefix, size_t limit) const {
+        settleIfLarge();
+        vector<Entry> hits;
+        auto it = partition_point(sorted.begin(), sorted.end(),
+                                  [&](const Entry& e) { return compareFolded(text(e), prefix) < 0; });
+        for (; it != sorted.end() && hits.size() < limit && startsWithFolded(text(*it), prefix); ++it) {
+            if (!(it->name & kDead)) hits.push_back(*it);
+        }
+        for (const Entry& e : pending) {
+            if (startsWithFolded(text(e), prefix)) hits.push_back(e);
+        }
+        sort(hits.begin(), hits.end(), [this](const Entry& a, const Entry& b) { return less(a, b); });
+        if (hits.size() > limit) hits.resize(limit);
+
+        vector<Match> result;
+        result.reserve(hits.size());
+        for (const Entry& e : hits) result.push_back(Match{e.id, 0});
+        return result;
+    }
+
+    // Names within maxEdits insertions/deletions/substitutions of query, closest first.
+    vector<Match> findFuzzy(string_view query, int maxEdits, size_t limit) const {
+        settleIfLarge();
+        struct Hit {
+            Entry entry;
+            int distance;
+        };
+        vector<Hit> hits;
+        const size_t m = query.size();
+        const size_t maxHits = max<size_t>(limit * 16, 256);
+        vector<vector<int>> rows(1, vector<int>(m + 1));
+        for (size_t j = 0; j <= m; ++j) rows[0][j] = static_cast<int>(j);
+
+        // [lo, hi) share the same first `depth` characters; rows[depth] is their edit row.
+        auto walk = [&](auto& self, size_t lo, size_t hi, size_t depth) -> void {
+            if (rows.size() <= depth + 1) rows.emplace_back(m + 1);
+            const int* row = rows[depth].data(); // row buffers stay put when rows grows
+            int* next = rows[depth + 1].data();
+            while (lo < hi && text(sorted[lo]).size() == depth) {
+                if (row[m] <= maxEdits && !(sorted[lo].name & kDead)) hits.push_back(Hit{sorted[lo], row[m]});
+                ++lo;
+            }
+            while (lo < hi && hits.size() < maxHits) {
+                char c = fold(text(sorted[lo])[depth]);
+                size_t end = static_cast<size_t>(
+                    partition_point(sorted.begin() + lo, sorted.begin() + hi,
+                                    [&](const Entry& e) { return fold(text(e)[depth]) == c; }) - sorted.begin());
+                next[0] = row[0] + 1;
+                int best = next[0];
+                for (size_t j = 1; j <= m; ++j) {
+                    next[j] = min({row[j] + 1, next[j - 1] + 1, row[j - 1] + (fold(query[j - 1]) != c)});
+                    best = min(best, next[j]);
+                }
+                if (best <= maxEdits) self(self, lo, end, depth + 1);
+                lo = end;
+            }
+        };
+        walk(walk, 0, sorted.size(), 0);
+
+        vector<int> scratch;
+        for (const Entry& e : pending) {
+            int distance = editDistance(text(e), query, maxEdits, scratch);
+            if (distance <= maxEdits) hits.push_back(Hit{e, distance});
+        }
+
+        sort(hits.begin(), hits.end(), [this](const Hit& a, const Hit& b) {
+            return a.distance != b.distance ? a.distance < b.distance : less(a.entry, b.entry);
+        });
+        if (hits.size() > limit) hits.resize(limit);
+
+        vector<Match> result;
+        result.reserve(hits.size());
+        for (const Hit& h : hits) result.push_back(Match{h.entry.id, h.distance});
+        return result;
+    }
+
+    size_t size() const { return sorted.size() - dead + pending.size(); }
+};
+
+// --------------------------------------Stock Limits
+// How many units a product may hold, and the level below which it is SHORT.
+struct StockLimits {
+    uint16_t capacity = 0;
+    uint16_t warning = 0; // SHORT below this many units
+
+    bool valid() const { return warning >= 1 && warning <= capacity; }
+    bool operator==(const StockLimits&) const = default;
+};
+
+/*
+ * Stock policies decide each storage slot's capacity and warning level for
+ * Inventory. Both take the limits as template defaults; Inventory asks by slot,
+ * which every hot path already holds, so a check is never an extra lookup.
+ *
+ * FixedStockPolicy: the same constants for every product. Every call folds to a
+ *   literal, so the checks compile exactly as hard-coded numbers would.
+ * StockClassPolicy: a 16-bit stock class per slot, kept in step with
+ *   ProductColumns, and one StockLimits per class. Class 0 holds the defaults;
+ *   per-product and per-category limits come from a StockLimitTable.
+ */
+template <int Capacity = 100, int Warning = 20>
+struct FixedStockPolicy {
+    static_assert(Warning >= 1 && Warning <= Capacity && Capacity <= 0xFFFF, "invalid stock limits");
+    static constexpr bool configurable = false;
+    static constexpr StockLimits kDefault{Capacity, Warning};
+
+    static constexpr int capacity(uint32_t) { return Capacity; }
+    static constexpr int warning(uint32_t) { return Warning; }
+    static constexpr int capacityFor(int) { return Capacity; }
+    static constexpr int minWarning() { return Warning; }
+    static constexpr int maxWarning() { return Warning; }
+
+    void place(uint32_t, int) {}
+    void placeAll(span<const int>) {}
+    void swapRemove(uint32_t) {}
+    void reserve(size_t) {}
+    void assign(span<const StockLimits>, const unordered_map<int, uint16_t>&, span<const int>) {}
+};
+
+template <int DefaultCapacity = 100, int DefaultWarning = 20>
+class StockClassPolicy {
+    static_assert(DefaultWarning >= 1 && DefaultWarning <= DefaultCapacity && DefaultCapacity <= 0xFFFF,
+                  "invalid stock limits");
+
+    vector<StockLimits> classes{kDefault};
+    vector<uint16_t> classOf;              // storage slot -> class
+    unordered_map<int, uint16_t> assigned; // product id -> class, for products outside class 0
+    int lowest = DefaultWarning, highest = DefaultWarning;
+
+    uint16_t classFor(int id) const {
+        if (assigned.empty()) return 0;
+        auto it = assigned.find(id);
+        return it == assigned.end() ? 0 : it->second;
+    }
+
+public:
+    static constexpr bool configurable = true;
+    static constexpr StockLimits kDefault{DefaultCapacity, DefaultWarning};
+
+    int capacity(uint32_t slot) const { return classes[classOf[slot]].capacity; }
+    int warning(uint32_t slot) const { return classes[classOf[slot]].warning; }
+    // For a product that has no slot yet (insert, bulk load).
+    int capacityFor(int id) const { return classes[classFor(id)].capacity; }
+    int minWarning() const { return lowest; }
+    int maxWarning() const { return highest; }
+
+    // The slot was just appended for product id.
+    void place(uint32_t slot, int id) {
+        classOf.resize(slot + 1);
+        classOf[slot] = classFor(id);
+    }
+
+    // Every slot at once; ids holds the product of each storage slot.
+    void placeAll(span<const int> ids) {
+        classOf.resize(ids.size());
+        for (size_t slot = 0; slot < ids.size(); ++slot) classOf[slot] = classFor(ids[slot]);
+    }
+
+    // Mirrors ProductColumns::swapRemove.
+    void swapRemove(uint32_t slot) {
+        classOf[slot] = classOf.back();
+        classOf.pop_back();
+    }
+
+    void reserve(size_t count) { classOf.reserve(count); }
+
+    // New classes and assignments; ids holds the product of every storage slot.
+    // Every class number in products must index limits, and limits must not be empty.
+    void assign(span<const StockLimits> limits, const unordered_map<int, uint16_t>& products, span<const int> ids) {
+        classes.assign(limits.begin(), limits.end());
+        assigned = products;
+        classOf.resize(ids.size());
+        for (size_t slot = 0; slot < ids.size(); ++slot) classOf[slot] = classFor(ids[slot]);
+        lowest = highest = classes[0].warning;
+        for (auto& c : classes) {
+            lowest = min<int>(lowest, c.warning);
+            highest = max<int>(highest, c.warning);
+        }
+    }
+};
+
+// Build with -DSUPERMARKET_FIXED_STOCK_LIMITS for the same limits everywhere at no runtime cost.
+#ifdef SUPERMARKET_FIXED_STOCK_LIMITS
+using StockPolicy = FixedStockPolicy<>;
+#else
+using StockPolicy = StockClassPolicy<>;
+#endif
+
+// Operator configuration behind StockClassPolicy: named stock classes (pallet, case,
+// ...) and the class of each product that is not "standard". Limits set on a single
+// product live in a class named after them ("<capacity>/<warning>"), shared by every
+// product with the same limits.
+class StockLimitTable {
+    vector<StockLimits> classes{StockPolicy::kDefault};
+    vector<string> names{"standard"};
+    unordered_map<int, uint16_t> products;
+
+    static bool validName(string_view name) {
+        return !name.empty() && name.find_first_of(" \t\r\n") == string_view::npos;
+    }
+
+public:
+    static constexpr const char* defaultPath = "stock_limits.txt";
+    static constexpr size_t kMaxClasses = 0x10000;
+
+    // Limits no stock level can break, for inventories that only mirror another store.
+    static StockLimitTable unbounded() {
+        StockLimitTable table;
+        table.defineClass("standard", StockLimits{0xFFFF, 1});
+        return table;
+    }
+
+    // -1 when there is no class of that name.
+    int findClass(string_view name) const {
+        auto it = find(names.begin(), names.end(), name);
+        return it == names.end() ? -1 : static_cast<int>(it - names.begin());
+    }
+
+    // Adds the class, or changes its limits for every product in it.
+    bool defineClass(const string& name, StockLimits limits) {
+        if (!validName(name) || !limits.valid()) return false;
+        int found = findClass(name);
+        if (found >= 0) {
+            classes[found] = limits;
+            return true;
+        }
+        if (classes.size() == kMaxClasses) return false;
+        classes.push_back(limits);
+        names.push_back(name);
+        return true;
+    }
+
+    bool assign(int productId, string_view className) {
+        int found = findClass(className);
+        if (found < 0) return false;
+        if (found == 0) products.erase(productId);
+        else products[productId] = static_cast<uint16_t>(found);
+        return true;
+    }
+
+    bool setProduct(int productId, StockLimits limits) {
+        string name = to_string(limits.capacity) + '/' + to_string(limits.warning);
+        if (findClass(name) < 0 && !defineClass(name, limits)) return false;
+        return assign(productId, name);
+    }
+
+    StockLimits limitsOf(int productId) const {
+        auto it = products.find(productId);
+        return classes[it == products.end() ? 0 : it->second];
+    }
+
+    const string& classOf(int productId) const {
+        auto it = products.find(productId);
+        return names[it == products.end() ? 0 : it->second];
+    }
+
+    span<const StockLimits> limits() const { return classes; }
+    span<const string> classNames() const { return names; }
+    const unordered_map<int, uint16_t>& assignments() const { return products; }
+
+    // "class <name> <capacity> <warning>" lines, then "product <id> <class>" in ID order.
+    bool saveFile(const string& filepath) const {
+        FileWriter out(filepath);
+        if (!out.isOpen()) return false;
+        for (size_t c = 0; c < classes.size(); ++c) {
+            out << "class " << names[c] << ' ' << classes[c].capacity << ' ' << classes[c].warning << '\n';
+        }
+        vector<pair<int, uint16_t>> sorted(products.begin(), products.end());
+        sort(sorted.begin(), sorted.end());
+        for (auto& [id, c] : sorted) out << "product " << id << ' ' << names[c] << '\n';
+        return out.finish();
+    }
+
+    // Returns how many lines were applied; malformed lines are skipped.
+    size_t loadFile(const string& filepath) {
+        ifstream in(filepath);
+        size_t loaded = 0;
+        string kind, name;
+        while (in >> kind) {
+            bool applied = false;
+            if (kind == "class") {
+                int capacity = 0, warning = 0;
+                in >> name >> capacity >> warning;
+                applied = in && capacity >= 0 && capacity <= 0xFFFF && warning >= 0 && warning <= capacity &&
+                          defineClass(name, StockLimits{static_cast<uint16_t>(capacity), static_cast<uint16_t>(warning)});
+            } else if (kind == "product") {
+                int id = 0;
+                in >> id >> name;
+                applied = in && assign(id, name);
+            }
+            if (!in) {
+                if (in.eof()) break;
+                in.clear();
+            } else if (applied) {
+                ++loaded;
+            }
+            in.ignore(numeric_limits<streamsize>::max(), '\n');
+        }
+        return loaded;
+    }
+};
+
+// --------------------------------------Low Stock
+// Indexed min-heap of the storage slots whose quantity is below their warning level,
+// ordered by (quantity, id). Every stock change updates it in O(log n), so the restock queue
+// costs O(k log k) in the number of short products instead of a catalog scan.
+class LowStockQueue {
+    static constexpr uint32_t npos = numeric_limits<uint32_t>::max();
+
+    const ProductColumns* products;
+    vector<uint32_t> heap;     // slots
+    vector<uint32_t> position; // slot -> heap index, npos when not queued
+
+    bool before(uint32_t a, uint32_t b) const {
+        int qa = products->quantities[a], qb = products->quantities[b];
+        return qa != qb ? qa < qb : products->ids[a] < products->ids[b];
+    }
+
+    void place(size_t i, uint32_t slot) {
+        heap[i] = slot;
+        position[slot] = static_cast<uint32_t>(i);
+    }
+
+    void siftUp(size_t i) {
+        uint32_t slot = heap[i];
+        while (i > 0 && before(slot, heap[(i - 1) / 2])) {
+            place(i, heap[(i - 1) / 2]);
+            i = (i - 1) / 2;
+        }
+        place(i, slot);
+    }
+
+    void siftDown(size_t i) {
+        uint32_t slot = heap[i];
+        for (size_t child; (child = 2 * i + 1) < heap.size(); i = child) {
+            if (child + 1 < heap.size() && before(heap[child + 1], heap[child])) ++child;
+            if (!before(heap[child], slot)) break;
+            place(i, heap[child]);
+        }
+        place(i, slot);
+    }
+
+    void removeAt(size_t i) {
+        position[heap[i]] = npos;
+        uint32_t last = heap.back();
+        heap.pop_back();
+        if (i == heap.size()) return;
+        place(i, last);
+        siftUp(i);
+        siftDown(position[last]);
+    }
+
+public:
+    explicit LowStockQueue(const ProductColumns& columns) : products(&columns) {}
+
+    // Call after the quantity or limits at slot changed (or the slot was filled);
+    // low tells whether the slot is now below its warning level.
+    void update(uint32_t slot, bool low) {
+        if (slot >= position.size()) position.resize(max<size_t>(slot + 1, position.size() * 2), npos);
+        uint32_t at = position[slot];
+        if (at == npos) {
+            if (!low) return;
+            heap.push_back(slot);
+            siftUp(heap.size() - 1);
+        } else if (!low) {
+            removeAt(at);
+        } else {
+            siftUp(at);
+            siftDown(position[slot]);
+        }
+    }
+
+    void remove(uint32_t slot) {
+        if (slot < position.size() && position[slot] != npos) removeAt(position[slot]);
+    }
+
+    // Replaces the queue with these low slots; a sorted array is already a heap.
+    void build(vector<uint32_t> slots) {
+        Parallel::sort(slots.begin(), slots.end(), [this](uint32_t a, uint32_t b) { return before(a, b); });
+        heap = move(slots);
+        position.assign(products->size(), npos);
+        for (size_t i = 0; i < heap.size(); ++i) position[heap[i]] = static_cast<uint32_t>(i);
+    }
+
+    // The row at `from` now lives at `to` (ProductColumns::swapRemove).
+    void relabel(uint32_t from, uint32_t to) {
+        if (from >= position.size() || position[from] == npos) return;
+        heap[position[from]] = to;
+        position[to] = position[from];
+        position[from] = npos;
+    }
+
+    // Queued slots, most urgent first.
+    vector<uint32_t> ordered() const {
+        vector<uint32_t> slots(heap);
+        sort(slots.begin(), slots.end(), [this](uint32_t a, uint32_t b) { return before(a, b); });
+        return slots;
+    }
+
+    const vector<uint32_t>& slots() const { return heap; }
+    size_t size() const { return heap.size(); }
+    bool empty() const { return heap.empty(); }
+
+    void clear() {
+        heap.clear();
+        position.clear();
+    }
+};
+
+// --------------------------------------Inventory
+// Scratch memory for one transaction: a monotonic arena over an inline buffer that
+// is released after every sale, so per-basket temporaries skip the global heap.
+class TransactionArena {
+    alignas(max_align_t) std::byte buffer[16 * 1024];
+    pmr::monotonic_buffer_resource arena{buffer, sizeof(buffer), pmr::new_delete_resource()};
+
+public:
+    class Scope {
+        TransactionArena& owner;
+
+    public:
+        explicit Scope(TransactionArena& owner) : owner(owner) {}
+        ~Scope() { owner.arena.release(); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    TransactionArena() = default;
+    TransactionArena(const TransactionArena&) = delete;
+    TransactionArena& operator=(const TransactionArena&) = delete;
+
+    pmr::memory_resource* resource() { return &arena; }
+};
+
+struct InventoryFilter {
+    int minId = numeric_limits<int>::min();
+    int maxId = numeric_limits<int>::max();
+    int belowQuantity = 0; // 0 = any stock level
+    string namePrefix;     // case-insensitive, empty = any name
+};
+
+// Running aggregates kept by every Inventory mutation: reading them never scans.
+struct InventoryTotals {
+    size_t skus = 0;
+    long long units = 0;
+    Cents stockValue = 0; // quantity x price, each price rounded to cents, so it never drifts
+    size_t emptyCount = 0;
+    size_t shortCount = 0; // above 0, below the product's warning level
+};
+
+struct InventoryPage {
+    size_t shown = 0;
+    bool more = false;  // another matching product follows
+    int nextCursor = 0; // pass back as `from` to continue
+};
+
+// One parsed row of a warm load (Inventory::warmLoad).
+struct WarmRow {
+    int id = 0;
+    int quantity = 0;
+    double price = 0.0;
+    uint64_t barcode = 0;
+    string_view name;
+    uint64_t nameHash = 0; // NameTable::hashOf(name)
+    bool valid = false;    // passed Inventory::checkRow
+};
+
+// Milliseconds per warm-load stage.
+struct WarmLoadTimings {
+    double parse = 0.0;   // decode and validate rows (parallel)
+    double merge = 0.0;   // product and barcode indexes, name interning (two threads)
+    double columns = 0.0; // fill the columns, totals and stock classes (parallel)
+    double indexes = 0.0; // name index and restock queue (parallel sorts)
+};
+
+class Inventory : public ICheckoutOperations, public IPrintable {
+    ProductColumns products;
+    NameIndex nameIndex{products.nameTable};
+    LowStockQueue lowStock{products};
+    StockPolicy limits;
+    InventoryTotals running;
+    TransactionArena scratch;
+    unique_ptr<IProductIndex> index;
+    BarcodeIndex barcodes;
+    const StaticBarcodeTable* catalog = &kStaticCatalog;
+    IInventoryEvents* events = &ConsoleInventoryEvents::instance();
+
+    // Adds (sign = 1) or removes (sign = -1) one row's share of the running totals.
+    void countRow(uint32_t slot, int sign) {
+        int quantity = products.quantities[slot];
+        running.skus += sign;
+        running.units += sign * quantity;
+        running.stockValue += sign * quantity * toCents(products.prices[slot]);
+        running.emptyCount += sign * (quantity == 0);
+    }
+
+    void changeStock(uint32_t slot, int delta) {
+        countRow(slot, -1);
+        products.quantities[slot] += delta;
+        products.touch(slot);
+        countRow(slot, 1);
+        lowStock.update(slot, isShort(slot));
+    }
+
+    bool isShort(uint32_t slot) const {
+        return products.quantities[slot] < limits.warning(slot);
+    }
+
+    bool report(InventoryEventType type, InventoryStatus status, int id, int amount = 0, int stock = 0,
+                string_view name = {}, double price = 0.0, uint64_t barcode = 0) const {
+        events->onEvent(InventoryEvent{type, status, id, amount, stock, name, price, barcode});
+        return status == InventoryStatus::Ok;
+    }
+
+    bool reportOverCapacity(InventoryEventType type, InventoryStatus status, int id, int capacity, int amount = 0,
+                            int stock = 0) const {
+        events->onEvent(InventoryEvent{type, status, id, amount, stock, {}, 0.0, 0, capacity});
+        return false;
+    }
+
+    // Ok, or why `code` cannot be given to a new product.
+    InventoryStatus checkBarcode(uint64_t code) const {
+        if (code == 0) return InventoryStatus::Ok;
+        if (!Barcode::valid(code)) return InventoryStatus::InvalidBarcode;
+        if (barcodes.find(code) != BarcodeIndex::npos) return InventoryStatus::DuplicateBarcode;
+        return InventoryStatus::Ok;
+    }
+
+    // Everything insertProduct and loadProduct check before claiming the id. A
+    // rejected row whose id is taken is reported as AlreadyExists.
+    InventoryStatus checkInsert(int id, string_view name, int quantity, uint64_t barcode) const {
+        InventoryStatus status = checkRow(id, name, quantity, barcode);
+        if (status == InventoryStatus::Ok) status = checkBarcode(barcode);
+        bool byValue = status != InventoryStatus::InvalidId && status != InventoryStatus::NameTooLong;
+        if (status != InventoryStatus::Ok && byValue && index->find(id) != IProductIndex::npos)
+            return InventoryStatus::AlreadyExists;
+        return status;
+    }
+
+    SaleView saleView(uint32_t slot, int amount) const {
+        return SaleView{products.ids[slot], products.names[slot], &products.nameTable,
+                        amount, products.quantities[slot], products.prices[slot]};
+    }
+
+    void warnStockLevel(uint32_t slot) const {
+        int quantity = products.quantities[slot];
+        if (quantity == 0)
+            report(InventoryEventType::StockEmpty, InventoryStatus::Ok, products.ids[slot], 0, quantity, products.name(slot));
+        else if (quantity < limits.warning(slot))
+            report(InventoryEventType::StockShort, InventoryStatus::Ok, products.ids[slot], 0, quantity, products.name(slot));
+        else if (quantity >= limits.capacity(slot))
+            report(InventoryEventType::StockFull, InventoryStatus::Ok, products.ids[slot], 0, quantity, products.name(slot));
+    }
+
+public:
+    explicit Inventory(IndexMode mode = IndexMode::FlatHash) : index(makeProductIndex(mode)) {}
+    Inventory(const Inventory&) = delete; // nameIndex and lowStock point into products
+    Inventory& operator=(const Inventory&) = delete;
+
+    void setEventSink(IInventoryEvents& sink) {
+        events = &sink;
+    }
+
+    IInventoryEvents& eventSink() const {
+        return *events;
+    }
+
+    bool insertProduct(const Product& p) override {
+        using T = InventoryEventType;
+        InventoryStatus status = checkInsert(p.id, p.name, p.quantity, p.barcode);
+        if (status == InventoryStatus::QuantityTooHigh) {
+            return reportOverCapacity(T::Insert, status, p.id, limits.capacityFor(p.id));
+        }
+        if (status != InventoryStatus::Ok) {
+            return report(T::Insert, status, p.id);
+        }
+        if (index->tryInsert(p.id, static_cast<uint32_t>(products.size())) != IProductIndex::npos) {
+            return report(T::Insert, InventoryStatus::AlreadyExists, p.id);
+        }
+        uint32_t slot = products.append(p);
+        limits.place(slot, p.id);
+        if (p.barcode) barcodes.insert(p.barcode, slot);
+        nameIndex.insert(p.id, products.names[slot]);
+        lowStock.update(slot, isShort(slot));
+        countRow(slot, 1);
+        return report(T::Insert, InventoryStatus::Ok, p.id, p.quantity, p.quantity, p.name, p.price, p.barcode);
+    }
+
+    bool deleteProduct(int id) override {
+        uint32_t slot = index->erase(id);
+        if (slot == IProductIndex::npos) {
+            return report(InventoryEventType::Delete, InventoryStatus::NotFound, id);
+        }
+        uint32_t last = static_cast<uint32_t>(products.size() - 1);
+        bool moved = slot != last;
+        nameIndex.erase(id, products.names[slot]);
+        if (products.barcodes[slot]) barcodes.erase(products.barcodes[slot]);
+        lowStock.remove(slot);
+        countRow(slot, -1);
+        products.swapRemove(slot);
+        limits.swapRemove(slot);
+        if (moved) {
+            index->assign(products.ids[slot], slot);
+            if (products.barcodes[slot]) barcodes.assign(products.barcodes[slot], slot);
+            lowStock.relabel(last, slot);
+        }
+        return report(InventoryEventType::Delete, InventoryStatus::Ok, id);
+    }
+
+    bool restockProduct(int id, int amount) override {
+        using T = InventoryEventType;
+        if (amount <= 0) {
+            return report(T::Restock, InventoryStatus::InvalidQuantity, id, amount);
+        }
+        uint32_t slot = index->find(id);
+        if (slot == IProductIndex::npos) {
+            return report(T::Restock, InventoryStatus::NotFound, id);
+        }
+        int quantity = products.quantities[slot];
+        if (int capacity = limits.capacity(slot); quantity + amount > capacity) {
+            return reportOverCapacity(T::Restock, InventoryStatus::CapacityExceeded, id, capacity, amount, quantity);
+        }
+        changeStock(slot, amount);
+        return report(T::Restock, InventoryStatus::Ok, id, amount, products.quantities[slot], products.name(slot));
+    }
+
+    bool sellProduct(int id, int amount, Product& outTaken) override {
+        using T = InventoryEventType;
+        if (amount <= 0) {
+            return report(T::Sell, InventoryStatus::InvalidQuantity, id, amount);
+        }
+        uint32_t slot = index->find(id);
+        if (slot == IProductIndex::npos) {
+            return report(T::Sell, InventoryStatus::NotFound, id);
+        }
+        int quantity = products.quantities[slot];
+        if (quantity < amount) {
+            return report(T::Sell, InventoryStatus::NotEnoughStock, id, amount, quantity, products.name(slot));
+        }
+        changeStock(slot, -amount);
+        outTaken = products.row(slot);
+        outTaken.quantity = amount;
+
+        //Warnings!!
+        warnStockLevel(slot);
+
+        return report(T::Sell, InventoryStatus::Ok, id, amount, products.quantities[slot], products.name(slot),
+                      products.prices[slot]);
+    }
+
+    // Allocation-free sale: the view refers to the stored name instead of copying it.
+    bool sellProduct(int id, int amount, SaleView& outSold) override {
+        using T = InventoryEventType;
+        if (amount <= 0) {
+            return report(T::Sell, InventoryStatus::InvalidQuantity, id, amount);
+        }
+        uint32_t slot = index->find(id);
+        if (slot == IProductIndex::npos) {
+            return report(T::Sell, InventoryStatus::NotFound, id);
+        }
+        int quantity = products.quantities[slot];
+        if (quantity < amount) {
+            return report(T::Sell, InventoryStatus::NotEnoughStock, id, amount, quantity, products.name(slot));
+        }
+        changeStock(slot, -amount);
+        outSold = saleView(slot, amount);
+
+        //Warnings!!
+        warnStockLevel(slot);
+
+        return report(T::Sell, InventoryStatus::Ok, id, amount, products.quantities[slot], products.name(slot),
+                      products.prices[slot]);
+    }
+
+    // Sells the whole basket or nothing: every line is validated before any stock moves.
+    bool sellBatch(span<const LineItem> basket, Reciept& receipt) override {
+        using T = InventoryEventType;
+        if (basket.empty()) {
+            return report(T::SellBatch, InventoryStatus::EmptyBasket, 0);
+        }
+
+        TransactionArena::Scope transaction(scratch);
+        pmr::vector<pair<uint32_t, int>> demand(scratch.resource());
+        demand.reserve(basket.size());
+        for (auto& line : basket) {
+            if (line.quantity <= 0) {
+                return report(T::SellBatch, InventoryStatus::InvalidQuantity, line.id, line.quantity);
+            }
+            uint32_t slot = index->find(line.id);
+            if (slot == IProductIndex::npos) {
+                return report(T::SellBatch, InventoryStatus::NotFound, line.id);
+            }
+            demand.emplace_back(slot, line.quantity);
+        }
+
+        // Repeated products in one basket are checked against their combined quantity.
+        pmr::vector<pair<uint32_t, int>> merged(demand, scratch.resource());
+        sort(merged.begin(), merged.end());
+        size_t unique = 0;
+        for (size_t i = 0; i < merged.size(); ++i) {
+            if (unique > 0 && merged[unique - 1].first == merged[i].first)
+                merged[unique - 1].second += merged[i].second;
+            else
+                merged[unique++] = merged[i];
+        }
+        merged.resize(unique);
+
+        for (auto& [slot, amount] : merged) {
+            if (products.quantities[slot] < amount) {
+                return report(T::SellBatch, InventoryStatus::NotEnoughStock, products.ids[slot],
+                              amount, products.quantities[slot], products.name(slot));
+            }
+        }
+
+        for (auto& [slot, amount] : merged) {
+            changeStock(slot, -amount);
+        }
+
+        receipt.reserve(receipt.lines().size() + demand.size());
+        for (auto& [slot, amount] : demand) {
+            receipt.addItem(saleView(slot, amount));
+        }
+
+        for (auto& [slot, amount] : merged) {
+            report(T::BasketLine, InventoryStatus::Ok, products.ids[slot], amount,
+                   products.quantities[slot], products.name(slot), products.prices[slot]);
+        }
+
+        //Warnings!!
+        for (auto& [slot, amount] : merged) {
+            warnStockLevel(slot);
+        }
+
+        return report(T::SellBatch, InventoryStatus::Ok, 0, static_cast<int>(basket.size()));
+    }
+
+    void showInventory() const override {
+        StreamWriter out(cout);
+        out << "\n=== INVENTORY STATUS ===\n";
+        if (products.empty()) {
+            out << "No products.\n";
+            return;
+        }
+        index->forEachOrdered([&](int, uint32_t slot) {
+            Product::writeDisplay(out, products.ids[slot], products.name(slot),
+                                  products.quantities[slot], products.prices[slot]);
+            out << '\n';
+        });
+    }
+
+    string getFileContent() const override {
+        return renderContent();
+    }
+
+    static void writeExportHeader(TextWriter& content, string_view timestamp) {
+        content << "=== INVENTORY EXPORT ===\n";
+        content << "Timestamp: " << timestamp << "\n\n";
+    }
+
+    void writeContent(TextWriter& content) const override {
+        writeExportHeader(content, TimeTools::timestamp());
+        index->forEachOrdered([&](int, uint32_t slot) {
+            Product::writeRecord(content, products.ids[slot], products.name(slot),
+                                 products.quantities[slot], products.prices[slot]);
+            content << '\n';
+        });
+    }
+
+    bool productExists(int id) const {
+        return index->find(id) != IProductIndex::npos;
+    }
+
+    bool findProduct(int id, Product& out) const {
+        uint32_t slot = index->find(id);
+        if (slot == IProductIndex::npos) return false;
+        out = products.row(slot);
+        return true;
+    }
+
+    // Scan lookup. A compiled-in catalog answers in one probe; barcodes assigned at
+    // runtime, or catalog entries whose product changed since, use the hash index.
+    bool resolveBarcode(uint64_t code, int& outId) const {
+        int id = 0;
+        if (catalog->find(code, id)) {
+            uint32_t slot = index->find(id);
+            if (slot != IProductIndex::npos && products.barcodes[slot] == code) {
+                outId = id;
+                return true;
+            }
+        }
+        uint32_t slot = barcodes.find(code);
+        if (slot == BarcodeIndex::npos) return false;
+        outId = products.ids[slot];
+        return true;
+    }
+
+    // Replaces the compiled-in catalog table (kStaticCatalog); the table must outlive the inventory.
+    void setStaticCatalog(const StaticBarcodeTable& table) {
+        catalog = &table;
+    }
+
+    // Writes up to pageSize matching products with id >= from, in ID order. The walk
+    // stops at the first match past the page, so cost follows what is displayed.
+    InventoryPage writePage(TextWriter& out, const InventoryFilter& filter, int from, size_t pageSize) const {
+        InventoryPage page;
+        index->forEachOrderedFrom(max(from, filter.minId), [&](int id, uint32_t slot) {
+            if (id > filter.maxId) return false;
+            if (filter.belowQuantity > 0 && products.quantities[slot] >= filter.belowQuantity) return true;
+            if (!filter.namePrefix.empty() && !NameIndex::startsWithFolded(products.name(slot), filter.namePrefix))
+                return true;
+            if (page.shown == pageSize) {
+                page.more = true;
+                page.nextCursor = id;
+                return false;
+            }
+            Product::writeDisplay(out, id, products.name(slot), products.quantities[slot], products.prices[slot]);
+            out << '\n';
+            ++page.shown;
+            return true;
+        });
+        return page;
+    }
+
+    // Name lookup for the cashier: prefix matches first, otherwise the closest
+    // names within one typo (two for queries of six characters or more).
+    vector<NameIndex::Match> searchByName(string_view query, size_t limit = 20) const {
+        vector<NameIndex::Match> matches = nameIndex.findPrefix(query, limit);
+        if (matches.empty() && !query.empty()) {
+            matches = nameIndex.findFuzzy(query, query.size() >= 6 ? 2 : 1, limit);
+        }
+        return matches;
+    }
+
+    void showProducts(span<const NameIndex::Match> matches) const {
+        StreamWriter out(cout);
+        for (auto& match : matches) {
+            uint32_t slot = index->find(match.id);
+            if (slot == IProductIndex::npos) continue;
+            Product::writeDisplay(out, products.ids[slot], products.name(slot),
+                                  products.quantities[slot], products.prices[slot]);
+            out << '\n';
+        }
+    }
+
+    void reserve(size_t count, size_t nameBytes = 0) {
+        products.reserve(count, nameBytes);
+        nameIndex.reserve(count);
+        index->reserve(count);
+        barcodes.reserve(count);
+        limits.reserve(count);
+    }
+
+    size_t size() const {
+        return products.size();
+    }
+
+    // The checks of loadProduct that need no other product; safe to call from any thread.
+    InventoryStatus checkRow(int id, string_view name, int quantity, uint64_t barcode) const {
+        if (!index->accepts(id)) return InventoryStatus::InvalidId;
+        if (name.size() > Product::kMaxNameLength) return InventoryStatus::NameTooLong;
+        if (quantity < 0) return InventoryStatus::InvalidQuantity;
+        if (quantity > limits.capacityFor(id)) return InventoryStatus::QuantityTooHigh;
+        if (barcode && !Barcode::valid(barcode)) return InventoryStatus::InvalidBarcode;
+        return InventoryStatus::Ok;
+    }
+
+    /*
+     * Bulk load into an empty inventory, storing the same products in the same slots
+     * as loadProduct on each row in turn. Returns how many rows were stored.
+     *   merge   - this thread claims ids and barcodes (first occurrence wins) while a
+     *             helper interns the names with their precomputed hashes
+     *   columns - every column is sized once and filled in parallel chunks, which also
+     *             sum their share of the running totals and collect their short slots
+     *   indexes - name index and restock queue are each built with one parallel sort
+     */
+    size_t warmLoad(span<const WarmRow> rows, size_t nameBytes, WarmLoadTimings& timings) {
+        if (!products.empty()) {
+            size_t stored = 0;
+            for (auto& r : rows) {
+                stored += r.valid && loadProduct(r.id, r.name, r.quantity, r.price, r.barcode) == InventoryStatus::Ok;
+            }
+            return stored;
+        }
+        constexpr size_t kGrain = 1 << 16;
+        auto elapsed = [start = TimeTools::nanos()]() mutable {
+            uint64_t now = TimeTools::nanos();
+            return (now - exchange(start, now)) / 1e6;
+        };
+
+        reserve(rows.size(), nameBytes);
+        vector<NameId> nameOf(rows.size());
+        thread namer([&] {
+            for (size_t i = 0; i < rows.size(); ++i) {
+                if (rows[i].valid) nameOf[i] = products.nameTable.intern(rows[i].name, rows[i].nameHash);
+            }
+        });
+        vector<uint32_t> taken; // row of each slot
+        taken.reserve(rows.size());
+        for (uint32_t i = 0; i < rows.size(); ++i) {
+            const WarmRow& r = rows[i];
+            if (!r.valid || (r.barcode && barcodes.find(r.barcode) != BarcodeIndex::npos)) continue;
+            uint32_t slot = static_cast<uint32_t>(taken.size());
+            if (index->tryInsert(r.id, slot) != IProductIndex::npos) continue;
+            if (r.barcode) barcodes.insert(r.barcode, slot);
+            taken.push_back(i);
+        }
+        namer.join();
+        timings.merge = elapsed();
+
+        size_t count = taken.size();
+        products.touched.clear(); // every page is new
+        products.ids.resize(count);
+        products.quantities.resize(count);
+        products.prices.resize(count);
+        products.names.resize(count);
+        products.barcodes.resize(count);
+        Parallel::forRange(count, kGrain, [&](size_t begin, size_t end) {
+            for (size_t slot = begin; slot < end; ++slot) {
+                const WarmRow& r = rows[taken[slot]];
+                products.ids[slot] = r.id;
+                products.quantities[slot] = r.quantity;
+                products.prices[slot] = r.price;
+                products.names[slot] = nameOf[taken[slot]];
+                products.barcodes[slot] = r.barcode;
+            }
+        });
+        limits.placeAll(products.ids);
+        struct Partial {
+            InventoryTotals totals;
+            vector<uint32_t> shortSlots;
+        };
+        vector<Partial> partials((count + kGrain - 1) / kGrain);
+        Parallel::forRange(count, kGrain, [&](size_t begin, size_t end) {
+            Partial& part = partials[begin / kGrain];
+            for (uint32_t slot = static_cast<uint32_t>(begin); slot < end; ++slot) {
+                int quantity = products.quantities[slot];
+                part.totals.units += quantity;
+                part.totals.stockValue += quantity * toCents(products.prices[slot]);
+                part.totals.emptyCount += quantity == 0;
+                if (isShort(slot)) part.shortSlots.push_back(slot);
+            }
+        });
+        running.skus = count;
+        vector<uint32_t> shortSlots;
+        for (auto& part : partials) {
+            running.units += part.totals.units;
+            running.stockValue += part.totals.stockValue;
+            running.emptyCount += part.totals.emptyCount;
+            shortSlots.insert(shortSlots.end(), part.shortSlots.begin(), part.shortSlots.end());
+        }
+        timings.columns = elapsed();
+
+        nameIndex.build(products.ids, products.names);
+        lowStock.build(move(shortSlots));
+        timings.indexes = elapsed();
+        return count;
+    }
+
+    // Silent insert for bulk loaders: same rules as insertProduct, no events.
+    InventoryStatus loadProduct(int id, string_view name, int quantity, double price, uint64_t barcode = 0) {
+        if (InventoryStatus status = checkInsert(id, name, quantity, barcode); status != InventoryStatus::Ok)
+            return status;
+        if (index->tryInsert(id, static_cast<uint32_t>(products.size())) != IProductIndex::npos)
+            return InventoryStatus::AlreadyExists;
+        uint32_t slot = products.append(id, name, quantity, price, barcode);
+        limits.place(slot, id);
+        if (barcode) barcodes.insert(barcode, slot);
+        nameIndex.insert(id, products.names[slot]);
+        lowStock.update(slot, isShort(slot));
+        countRow(slot, 1);
+        return InventoryStatus::Ok;
+    }
+
+    const ProductColumns& columns() const {
+        return products;
+    }
+
+    // Starts a new round of ProductColumns::touched, after a snapshot copied the pages.
+    void clearTouchedPages() {
+        products.clearTouched();
+    }
+
+    // Indexed by storage slot, like columns().
+    const StockPolicy& stockPolicy() const {
+        return limits;
+    }
+
+    bool fitsStockLimits(const StockLimitTable& table, int* overfull = nullptr) const {
+        for (uint32_t slot = 0; slot < products.size(); ++slot) {
+            if (products.quantities[slot] > table.limitsOf(products.ids[slot]).capacity) {
+                if (overfull) *overfull = products.ids[slot];
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Takes capacities and warning levels from the table. Returns false, changing
+    // nothing, when this build has fixed limits or a product already holds more than
+    // its new capacity (its ID goes to overfull).
+    bool setStockLimits(const StockLimitTable& table, int* overfull = nullptr) {
+        if (!StockPolicy::configurable || !fitsStockLimits(table, overfull)) return false;
+        limits.assign(table.limits(), table.assignments(), products.ids);
+        for (uint32_t slot = 0; slot < products.size(); ++slot) lowStock.update(slot, isShort(slot));
+        return true;
+    }
+
+    // Appends every product in storage order (unsorted).
+    void appendProducts(vector<Product>& out) const {
+        out.reserve(out.size() + products.size());
+        for (uint32_t slot = 0; slot < products.size(); ++slot) {
+            out.push_back(products.row(slot));
+        }
+    }
+
+    // --- column reports: each is one linear pass over contiguous arrays
+    vector<int> lowStockIds(int threshold = StockPolicy::kDefault.warning) const {
+        vector<int> result;
+        if (threshold <= limits.minWarning()) { // every such product is in the queue
+            for (uint32_t slot : lowStock.slots()) {
+                if (products.quantities[slot] < threshold) result.push_back(products.ids[slot]);
+            }
+            sort(result.begin(), result.end());
+            return result;
+        }
+        const int* quantities = products.quantities.data();
+        for (size_t i = 0, n = products.size(); i < n; ++i) {
+            if (quantities[i] < threshold) result.push_back(products.ids[i]);
+        }
+        sort(result.begin(), result.end());
+        return result;
+    }
+
+    size_t countBelow(int threshold) const {
+        if (threshold == limits.minWarning() && threshold == limits.maxWarning()) return lowStock.size();
+        size_t count = 0;
+        const int* quantities = products.quantities.data();
+        for (size_t i = 0, n = products.size(); i < n; ++i) {
+            count += quantities[i] < threshold;
+        }
+        return count;
+    }
+
+    long long totalUnits() const {
+        return running.units;
+    }
+
+    Cents totalStockValue() const {
+        return running.stockValue;
+    }
+
+    InventoryTotals totals() const {
+        InventoryTotals current = running;
+        current.shortCount = lowStock.size() - running.emptyCount;
+        return current;
+    }
+
+    // Short products (below their warning level), lowest stock first.
+    vector<int> restockQueue() const {
+        vector<int> ids;
+        ids.reserve(lowStock.size());
+        for (uint32_t slot : lowStock.ordered()) ids.push_back(products.ids[slot]);
+        return ids;
+    }
+
+    void writeRestockQueue(TextWriter& out) const {
+        out << "=== RESTOCK QUEUE (below warning level) ===\n";
+        if (lowStock.empty()) {
+            out << "Nothing to restock.\n";
+            return;
+        }
+        for (uint32_t slot : lowStock.ordered()) {
+            out << "ID: " << products.ids[slot] << " | Name: " << products.name(slot)
+                << " | Qty: " << products.quantities[slot]
+                << " | Needs: " << (limits.capacity(slot) - products.quantities[slot]) << '\n';
+        }
+    }
+
+    // Tops every queued product up to target (or its capacity, if lower) through
+    // restockProduct, so each one is validated, reported and journaled like a manual
+    // restock. Returns how many moved.
+    size_t restockAllTo(int target) {
+        size_t restocked = 0;
+        for (int id : restockQueue()) {
+            uint32_t slot = index->find(id);
+            int amount = min(target, limits.capacity(slot)) - products.quantities[slot];
+            if (amount > 0 && restockProduct(id, amount)) ++restocked;
+        }
+        return restocked;
+    }
+
+    // Applies a whole restock plan in one call; each line goes through restockProduct
+    // (validated, reported, journaled). Returns how many lines were applied.
+    size_t restockBatch(span<const LineItem> lines) {
+        size_t restocked = 0;
+        for (auto& line : lines) restocked += restockProduct(line.id, line.quantity);
+        return restocked;
+    }
+
+    // Products below the threshold with the amount needed to refill them to capacity.
+    string restockReport(int threshold = StockPolicy::kDefault.warning) const {
+        stringstream report;
+        report << "=== RESTOCK REPORT (below " << threshold << ") ===\n";
+        for (int id : lowStockIds(threshold)) {
+            uint32_t slot = index->find(id);
+            report << "ID: " << id << " | Name: " << products.name(slot)
+                   << " | Qty: " << products.quantities[slot]
+                   << " | Needs: " << (limits.capacity(slot) - products.quantities[slot]) << "\n";
+        }
+        return report.str();
+    }
+};
+
+// --------------------------------------Snapshot
+/*
+ * Binary snapshot layout (version 3, little-endian):
+ *   SnapshotHeader          version 1 files stop before walSequence
+ *   SnapshotRecord[count]   fixed 24-byte rows
+ *   char[stringBytes]       product names, referenced by offset/length
+ *   uint64_t[count]         barcodes (0 = none); absent before version 3
+ */
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+    uint64_t stringBytes;
+    uint64_t walSequence; // last write-ahead log record already contained in the snapshot
+};
+
+struct SnapshotRecord {
+    int32_t id;
+    int32_t quantity;
+    double price;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+};
+
+static_assert(sizeof(SnapshotHeader) == 32 && sizeof(SnapshotRecord) == 24, "snapshot layout must stay fixed");
+
+class InventorySnapshot : public IPrintable {
+    const Inventory& inventory;
+    uint64_t walSequence;
+
+public:
+    static constexpr char magic[4] = {'S', 'M', 'K', 'S'};
+    static constexpr uint32_t version = 3;
+    static constexpr size_t headerSizeV1 = 24;
+    static constexpr const char* defaultPath = "inventory.snapshot";
+
+    struct LoadResult {
+        bool ok = false;
+        size_t loaded = 0;
+        size_t rejected = 0;
+        uint64_t walSequence = 0;
+        double millis = 0.0;
+        bool warm = false; // loaded into an empty inventory through Inventory::warmLoad
+        WarmLoadTimings stages;
+    };
+
+    explicit InventorySnapshot(const Inventory& inv, uint64_t walSequence = 0)
+        : inventory(inv), walSequence(walSequence) {}
+
+    // Binary content; IPrintable keeps the export path identical to the text reports.
+    string getFileContent() const override {
+        const ProductColumns& cols = inventory.columns();
+        string strings;
+        vector<SnapshotRecord> records(cols.size());
+        for (uint32_t slot = 0; slot < cols.size(); ++slot) {
+            string_view name = cols.name(slot);
+            records[slot] = SnapshotRecord{cols.ids[slot], cols.quantities[slot], cols.prices[slot],
+                                           static_cast<uint32_t>(strings.size()),
+                                           static_cast<uint32_t>(name.size())};
+            strings.append(name);
+        }
+
+        SnapshotHeader header{};
+        memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.count = records.size();
+        header.stringBytes = strings.size();
+        header.walSequence = walSequence;
+
+        string bytes;
+        bytes.reserve(sizeof(header) + records.size() * (sizeof(SnapshotRecord) + sizeof(uint64_t)) + strings.size());
+        bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        bytes.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(SnapshotRecord));
+        bytes.append(strings);
+        bytes.append(reinterpret_cast<const char*>(cols.barcodes.data()), cols.barcodes.size() * sizeof(uint64_t));
+        return bytes;
+    }
+
+    bool printToFile(const string& filepath) const override {
+        return FileExporter::exportBinary(getFileContent(), filepath);
+    }
+
+    static LoadResult load(const string& filepath, Inventory& into) {
+        MappedFile file(filepath);
+        if (!file.isOpen()) return LoadResult{};
+        return loadBytes(string_view(file.data(), file.size()), into);
+    }
+
+    // Last write-ahead log sequence contained in snapshot bytes.
+    static bool readSequence(string_view bytes, uint64_t& outSequence) {
+        SnapshotHeader header{};
+        if (bytes.size() < headerSizeV1) return false;
+        memcpy(&header, bytes.data(), headerSizeV1);
+        if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version < 1 || header.version > version)
+            return false;
+        if (header.version > 1) {
+            if (bytes.size() < sizeof(SnapshotHeader)) return false;
+            memcpy(&header, bytes.data(), sizeof(SnapshotHeader));
+        }
+        outSequence = header.walSequence;
+        return true;
+    }
+
+    static LoadResult loadBytes(string_view file, Inventory& into) {
+        LoadResult result;
+        auto start = chrono::steady_clock::now();
+        if (file.size() < headerSizeV1) return result;
+
+        SnapshotHeader header{};
+        memcpy(&header, file.data(), headerSizeV1);
+        if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version < 1 || header.version > version)
+            return result;
+        size_t headerSize = header.version == 1 ? headerSizeV1 : sizeof(SnapshotHeader);
+        if (file.size() < headerSize) return result;
+        memcpy(&header, file.data(), headerSize);
+
+        size_t recordBytes = header.count * sizeof(SnapshotRecord);
+        size_t barcodeBytes = header.version >= 3 ? header.count * sizeof(uint64_t) : 0;
+        if (header.count > file.size() / sizeof(SnapshotRecord) || header.stringBytes > file.size() ||
+            headerSize + recordBytes + header.stringBytes + barcodeBytes > file.size()) return result;
+
+        const char* recordBase = file.data() + headerSize;
+        string_view strings(recordBase + recordBytes, header.stringBytes);
+        const char* barcodeBase = strings.data() + strings.size();
+
+        if (into.size() == 0) {
+            // Restart path: parse in parallel chunks, then bulk-build the inventory.
+            vector<WarmRow> rows(header.count);
+            Parallel::forRange(rows.size(), 1 << 16, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    SnapshotRecord r;
+                    memcpy(&r, recordBase + i * sizeof(SnapshotRecord), sizeof(r));
+                    WarmRow& row = rows[i];
+                    if (barcodeBytes) memcpy(&row.barcode, barcodeBase + i * sizeof(uint64_t), sizeof(row.barcode));
+                    if (static_cast<uint64_t>(r.nameOffset) + r.nameLength > header.stringBytes) continue;
+                    row.id = r.id;
+                    row.quantity = r.quantity;
+                    row.price = r.price;
+                    row.name = strings.substr(r.nameOffset, r.nameLength);
+                    row.nameHash = NameTable::hashOf(row.name);
+                    row.valid = into.checkRow(r.id, row.name, r.quantity, row.barcode) == InventoryStatus::Ok;
+                }
+            });
+            result.stages.parse = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            result.loaded = into.warmLoad(rows, header.stringBytes, result.stages);
+            result.rejected = header.count - result.loaded;
+            result.warm = true;
+            result.ok = true;
+            result.walSequence = header.walSequence;
+            result.millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            return result;
+        }
+
+        into.reserve(into.size() + header.count, header.stringBytes);
+        for (size_t i = 0; i < header.count; ++i) {
+            SnapshotRecord r;
+            memcpy(&r, recordBase + i * sizeof(SnapshotRecord), sizeof(r));
+            uint64_t barcode = 0;
+            if (barcodeBytes) memcpy(&barcode, barcodeBase + i * sizeof(uint64_t), sizeof(barcode));
+            if (static_cast<uint64_t>(r.nameOffset) + r.nameLength > header.stringBytes ||
+                into.loadProduct(r.id, strings.substr(r.nameOffset, r.nameLength), r.quantity, r.price, barcode)
+                    != InventoryStatus::Ok) {
+                ++result.rejected;
+                continue;
+            }
+            ++result.loaded;
+        }
+
+        result.ok = true;
+        result.walSequence = header.walSequence;
+        result.millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        return result;
+    }
+};
+
+// --------------------------------------Write-Ahead Log
+/*
+ * File layout: WalHeader, then records of
+ *   [u16 payload length][u8 op][payload][u32 checksum of op + payload]
+ * Record n (0-based) has sequence number baseSequence + n. Replay stops at the
+ * first torn or corrupt record, which is what a crash mid-write leaves behind.
+ */
+struct WalHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t baseSequence;
+};
+
+// InsertBarcoded carries a barcode before the name; plain Insert records stay as they were.
+enum class WalOp : uint8_t { Insert = 1, Delete = 2, Restock = 3, Sell = 4, InsertBarcoded = 5 };
+
+// Subscribes to inventory events and journals every successful mutation.
+// Group commit: a background thread writes and fsyncs whatever accumulated
+// since the last flush, so concurrent lanes share one disk flush.
+class WriteAheadLog : public IInventoryEvents {
+public:
+    enum class CommitMode {
+        Sync,   // a mutation returns once its record is durable
+        Async   // records are flushed every commitInterval; a crash loses at most that window
+    };
+
+    struct ReplayResult {
+        bool ok = false;
+        size_t applied = 0;
+        size_t skipped = 0;     // already contained in the snapshot
+        uint64_t lastSequence = 0;
+        size_t validBytes = 0;
+    };
+
+    static constexpr char magic[4] = {'S', 'M', 'K', 'W'};
+    static constexpr uint32_t version = 1;
+    static constexpr const char* defaultPath = "inventory.wal";
+
+private:
+    string path;
+    CommitMode mode;
+    chrono::milliseconds commitInterval;
+    size_t groupBytes;
+
+    FILE* file = nullptr;
+    mutex lock;
+    condition_variable flushNeeded;
+    condition_variable flushed;
+    string pending;
+    uint64_t nextSequence = 1;      // sequence of the next appended record
+    uint64_t durableSequence = 0;   // every record up to this one is on disk
+    size_t waiters = 0;
+    bool stopping = false;
+    bool failed = false;            // a write or fsync failed; nothing after it is durable
+    thread flusher;
+    function<void(uint64_t, string_view)> tap;
+
+    static uint32_t checksum(const char* data, size_t size) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+        }
+        return hash;
+    }
+
+    template <typename T>
+    static void put(string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static void encode(string& out, WalOp op, int id, int amount, double price = 0.0, string_view name = {},
+                       uint64_t barcode = 0) {
+        size_t start = out.size();
+        put<uint16_t>(out, 0);
+        put<uint8_t>(out, static_cast<uint8_t>(op));
+        put<int32_t>(out, id);
+        if (op != WalOp::Delete) put<int32_t>(out, amount);
+        if (op == WalOp::Insert || op == WalOp::InsertBarcoded) {
+            put<double>(out, price);
+            if (op == WalOp::InsertBarcoded) put<uint64_t>(out, barcode);
+            out.append(name); // at most Product::kMaxNameLength, checked on insert
+        }
+        uint16_t length = static_cast<uint16_t>(out.size() - start - sizeof(uint16_t) - 1);
+        memcpy(&out[start], &length, sizeof(length));
+        put<uint32_t>(out, checksum(out.data() + start + sizeof(uint16_t), length + 1));
+    }
+
+    static bool syncToDisk(FILE* f) {
+        if (fflush(f) != 0) return false;
+#ifdef _WIN32
+        return FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(f)))) != 0;
+#else
+        return fsync(fileno(f)) == 0;
+#endif
+    }
+
+    bool writeHeader(uint64_t baseSequence) {
+        WalHeader header{};
+        memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.baseSequence = baseSequence;
+        return fwrite(&header, sizeof(header), 1, file) == 1 && syncToDisk(file);
+    }
+
+    void flushLoop() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            flushNeeded.wait_for(guard, commitInterval, [&] {
+                return stopping || (!pending.empty() && (waiters > 0 || pending.size() >= groupBytes));
+            });
+            if (failed) pending.clear(); // the file may end in a torn batch; stop adding to it
+            if (pending.empty()) {
+                if (stopping) return;
+                continue;
+            }
+            string batch;
+            batch.swap(pending);
+            uint64_t batchEnd = nextSequence - 1;
+            guard.unlock();
+
+            bool ok = fwrite(batch.data(), 1, batch.size(), file) == batch.size() && syncToDisk(file);
+
+            guard.lock();
+            if (ok) durableSequence = batchEnd;
+            else failed = true;
+            flushed.notify_all();
+        }
+    }
+
+    void append(WalOp op, int id, int amount, double price = 0.0, string_view name = {}, uint64_t barcode = 0) {
+        unique_lock<mutex> guard(lock);
+        if (!file) return;
+        size_t start = pending.size();
+        encode(pending, op, id, amount, price, name, barcode);
+        uint64_t sequence = nextSequence++;
+        if (tap) tap(sequence, string_view(pending).substr(start));
+        if (mode == CommitMode::Sync) {
+            ++waiters;
+            flushNeeded.notify_one();
+            flushed.wait(guard, [&] { return durableSequence >= sequence || failed; });
+            --waiters;
+        } else if (pending.size() >= groupBytes) {
+            flushNeeded.notify_one();
+        }
+    }
+
+public:
+    explicit WriteAheadLog(string path = defaultPath, CommitMode mode = CommitMode::Sync,
+                           chrono::milliseconds commitInterval = chrono::milliseconds(5),
+                           size_t groupBytes = 64 * 1024)
+        : path(move(path)), mode(mode), commitInterval(commitInterval), groupBytes(groupBytes) {}
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    ~WriteAheadLog() {
+        close();
+    }
+
+    // Opens the log for appending after `lastSequence`. A valid file is kept up to
+    // validBytes (dropping a torn tail); anything else is started over.
+    bool open(uint64_t lastSequence, size_t validBytes) {
+        close();
+        unique_lock<mutex> guard(lock); // replication reads the sequences from its own thread
+        error_code ec;
+        bool keep = validBytes >= sizeof(WalHeader) && filesystem::exists(path, ec);
+        if (keep) filesystem::resize_file(path, validBytes, ec);
+        file = fopen(path.c_str(), keep && !ec ? "ab" : "wb");
+        if (!file) return false;
+        nextSequence = lastSequence + 1;
+        durableSequence = lastSequence;
+        if ((!keep || ec) && !writeHeader(nextSequence)) {
+            fclose(file);
+            file = nullptr;
+            return false;
+        }
+        stopping = false;
+        failed = false;
+        guard.unlock();
+        flusher = thread(&WriteAheadLog::flushLoop, this);
+        return true;
+    }
+
+    void close() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+            flushNeeded.notify_one();
+        }
+        if (flusher.joinable()) flusher.join();
+        lock_guard<mutex> guard(lock);
+        if (file) {
+            fclose(file);
+            file = nullptr;
+        }
+    }
+
+    // Blocks until every record appended so far is durable; false if the log
+    // failed first (see healthy()).
+    bool sync() {
+        unique_lock<mutex> guard(lock);
+        uint64_t target = nextSequence - 1;
+        if (durableSequence >= target) return true;
+        if (failed) return false;
+        ++waiters;
+        flushNeeded.notify_one();
+        flushed.wait(guard, [&] { return durableSequence >= target || failed; });
+        --waiters;
+        return durableSequence >= target;
+    }
+
+    uint64_t lastSequence() {
+        lock_guard<mutex> guard(lock);
+        return nextSequence - 1;
+    }
+
+    // Sees every appended record with its sequence, under the log's lock (replication).
+    void setTap(function<void(uint64_t sequence, string_view record)> observer) {
+        lock_guard<mutex> guard(lock);
+        tap = move(observer);
+    }
+
+    bool healthy() {
+        lock_guard<mutex> guard(lock);
+        return file && !failed;
+    }
+
+    // Starts a fresh, empty log once a snapshot holds everything up to lastSequence().
+    bool truncate() {
+        sync();
+        uint64_t last = lastSequence();
+        close();
+        return open(last, 0);
+    }
+
+    void onEvent(const InventoryEvent& e) override {
+        if (e.status != InventoryStatus::Ok) return;
+        switch (e.type) {
+            case InventoryEventType::Insert:
+                append(e.barcode ? WalOp::InsertBarcoded : WalOp::Insert, e.id, e.amount, e.price, e.name, e.barcode);
+                break;
+            case InventoryEventType::Delete: append(WalOp::Delete, e.id, 0); break;
+            case InventoryEventType::Restock: append(WalOp::Restock, e.id, e.amount); break;
+            case InventoryEventType::Sell:
+            case InventoryEventType::BasketLine: append(WalOp::Sell, e.id, e.amount); break;
+            default: break;
+        }
+    }
+
+    struct Record {
+        WalOp op;
+        const char* payload;
+        uint16_t length;
+    };
+
+    // Size of the well-formed record at data, or 0 when it is torn or corrupt.
+    static size_t readRecord(const char* data, size_t size, Record& out) {
+        if (size < sizeof(uint16_t) + 1 + sizeof(uint32_t)) return 0;
+        uint16_t length;
+        memcpy(&length, data, sizeof(length));
+        const char* body = data + sizeof(uint16_t);
+        size_t total = sizeof(uint16_t) + 1 + length + sizeof(uint32_t);
+        if (total > size) return 0;
+        uint32_t stored;
+        memcpy(&stored, body + 1 + length, sizeof(stored));
+        if (stored != checksum(body, length + 1u)) return 0;
+        out = Record{static_cast<WalOp>(body[0]), body + 1, length};
+        return total;
+    }
+
+    static void apply(const Record& record, IInventoryOperations& target) {
+        const char* payload = record.payload;
+        uint16_t length = record.length;
+        int32_t id = 0, amount = 0;
+        if (length >= 4) memcpy(&id, payload, 4);
+        if (length >= 8) memcpy(&amount, payload + 4, 4);
+        Product taken;
+        switch (record.op) {
+            case WalOp::Insert: {
+                if (length < 16) break;
+                Product p;
+                p.id = id;
+                p.quantity = amount;
+                memcpy(&p.price, payload + 8, sizeof(double));
+                p.name.assign(payload + 16, length - 16);
+                target.insertProduct(p);
+                break;
+            }
+            case WalOp::InsertBarcoded: {
+                if (length < 24) break;
+                Product p;
+                p.id = id;
+                p.quantity = amount;
+                memcpy(&p.price, payload + 8, sizeof(double));
+                memcpy(&p.barcode, payload + 16, sizeof(uint64_t));
+                p.name.assign(payload + 24, length - 24);
+                target.insertProduct(p);
+                break;
+            }
+            case WalOp::Delete: target.deleteProduct(id); break;
+            case WalOp::Restock: target.restockProduct(id, amount); break;
+            case WalOp::Sell: target.sellProduct(id, amount, taken); break;
+        }
+    }
+
+    // Re-applies every record newer than afterSequence through the regular mutation surface.
+    static ReplayResult replay(const string& filepath, IInventoryOperations& target, uint64_t afterSequence) {
+        ReplayResult result;
+        result.lastSequence = afterSequence;
+
+        MappedFile file(filepath);
+        if (!file.isOpen() || file.size() < sizeof(WalHeader)) return result;
+
+        WalHeader header;
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version) return result;
+
+        size_t pos = sizeof(WalHeader);
+        uint64_t sequence = header.baseSequence;
+        Record record;
+        while (size_t size = readRecord(file.data() + pos, file.size() - pos, record)) {
+            if (sequence <= afterSequence) {
+                ++result.skipped;
+            } else {
+                apply(record, target);
+                ++result.applied;
+            }
+            result.lastSequence = sequence;
+            ++sequence;
+            pos += size;
+        }
+
+        result.ok = true;
+        result.validBytes = pos;
+        return result;
+    }
+};
+
+// --------------------------------------Persistence
+// Snapshot + write-ahead log: restore() rebuilds the inventory after a restart or
+// crash, saveSnapshot() checkpoints and starts an empty log.
+class InventoryPersistence {
+    string snapshotPath;
+    string walPath;
+    WriteAheadLog wal;
+    unique_ptr<TeeInventoryEvents> journaled;
+
+public:
+    struct RestoreResult {
+        InventorySnapshot::LoadResult snapshot;
+        WriteAheadLog::ReplayResult log;
+        bool journaling = false;
+    };
+
+    explicit InventoryPersistence(string snapshotPath = InventorySnapshot::defaultPath,
+                                  string walPath = WriteAheadLog::defaultPath,
+                                  WriteAheadLog::CommitMode mode = WriteAheadLog::CommitMode::Sync)
+        : snapshotPath(snapshotPath), walPath(walPath), wal(walPath, mode) {}
+
+    // Loads the snapshot, replays newer log records, then journals every further mutation.
+    RestoreResult restore(Inventory& inventory) {
+        RestoreResult result;
+        IInventoryEvents& sink = inventory.eventSink();
+        inventory.setEventSink(NullInventoryEvents::instance());
+
+        result.snapshot = InventorySnapshot::load(snapshotPath, inventory);
+        result.log = WriteAheadLog::replay(walPath, inventory, result.snapshot.walSequence);
+
+        uint64_t last = max(result.log.lastSequence, result.snapshot.walSequence);
+        result.journaling = wal.open(last, result.log.ok ? result.log.validBytes : 0);
+
+        journaled = make_unique<TeeInventoryEvents>(sink, wal);
+        inventory.setEventSink(result.journaling ? static_cast<IInventoryEvents&>(*journaled) : sink);
+        return result;
+    }
+
+    bool saveSnapshot(const Inventory& inventory) {
+        wal.sync();
+        string temp = snapshotPath + ".tmp";
+        if (!InventorySnapshot(inventory, wal.lastSequence()).printToFile(temp)) return false;
+        error_code ec;
+        filesystem::rename(temp, snapshotPath, ec);
+        if (ec) return false;
+        // Records up to the snapshot's sequence are skipped on replay, so a crash
+        // before this truncation cannot apply them twice.
+        return wal.truncate();
+    }
+
+    WriteAheadLog& log() {
+        return wal;
+    }
+
+    const string& snapshotFile() const {
+        return snapshotPath;
+    }
+
+    const string& walFile() const {
+        return walPath;
+    }
+};
+
+// --------------------------------------Replication
+/*
+ * Branch -> headquarters replication. A branch streams its write-ahead log
+ * records (the mutation records the log already replays) to a ReplicationHub:
+ *   frame = [u32 body length][u8 ReplicationFrame][body]
+ *   Hello{u32 branch}                         -> HelloAck{u8 known, u64 lastApplied}
+ *   Baseline{u64 sequence, u32 raw, lz bytes}  -> Ack{u8 status, u64 lastApplied}
+ *   Batch{u64 first, u32 count, u32 raw, lz}   -> Ack{u8 status, u64 lastApplied}
+ *   QueryStock{i32 id} -> StockReply, QueryTotals{} -> TotalsReply
+ * The hub applies a record only when its sequence follows the branch's last
+ * applied one, so resends are harmless. When the hub has no usable state for a
+ * branch (first contact, hub restart, branch queue overflow) the branch sends
+ * a baseline rebuilt from its snapshot and log files, then resumes the stream.
+ */
+
+// Blocking TCP socket (RAII, move-only).
+class Socket {
+#ifdef _WIN32
+    using Handle = SOCKET;
+    static constexpr Handle invalid = INVALID_SOCKET;
+#else
+    using Handle = int;
+    static constexpr Handle invalid = -1;
+#endif
+    Handle handle = invalid;
+
+    static void startup() {
+#ifdef _WIN32
+        static WSADATA data;
+        static int started = WSAStartup(MAKEWORD(2, 2), &data);
+        (void)started;
+#endif
+    }
+
+    explicit Socket(Handle handle) : handle(handle) {}
+
+public:
+    Socket() = default;
+    Socket(Socket&& other) noexcept : handle(exchange(other.handle, invalid)) {}
+    Socket& operator=(Socket&& other) noexcept {
+        if (this != &other) {
+            close();
+            handle = exchange(other.handle, invalid);
+        }
+        return *this;
+    }
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+    ~Socket() { close(); }
+
+    bool valid() const { return handle != invalid; }
+    Handle native() const { return handle; }
+
+    bool setNonBlocking() {
+#ifdef _WIN32
+        u_long on = 1;
+        return ioctlsocket(handle, FIONBIO, &on) == 0;
+#else
+        int flags = fcntl(handle, F_GETFL, 0);
+        return flags >= 0 && fcntl(handle, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+    }
+
+    void close() {
+        if (handle == invalid) return;
+#ifdef _WIN32
+        closesocket(handle);
+#else
+        ::close(handle);
+#endif
+        handle = invalid;
+    }
+
+    // Wakes a thread blocked in accept() or recv() on this socket.
+    void shutdownBoth() {
+        if (handle == invalid) return;
+#ifdef _WIN32
+        ::shutdown(handle, SD_BOTH);
+#else
+        ::shutdown(handle, SHUT_RDWR);
+#endif
+    }
+
+    static Socket connectTo(const string& host, uint16_t port) {
+        startup();
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* found = nullptr;
+        if (getaddrinfo(host.c_str(), to_string(port).c_str(), &hints, &found) != 0) return Socket();
+        Socket result;
+        for (addrinfo* a = found; a && !result.valid(); a = a->ai_next) {
+            Socket candidate(::socket(a->ai_family, a->ai_socktype, a->ai_protocol));
+            if (!candidate.valid()) continue;
+            if (::connect(candidate.handle, a->ai_addr, static_cast<int>(a->ai_addrlen)) == 0) result = move(candidate);
+        }
+        freeaddrinfo(found);
+        if (result.valid()) {
+            int one = 1;
+            setsockopt(result.handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+        }
+        return result;
+    }
+
+    // Port 0 picks a free port (see localPort()). With sharePort, several sockets
+    // can listen on one port and the kernel spreads connections across them.
+    static Socket listenOn(uint16_t port, bool sharePort = false) {
+        startup();
+        Socket s(::socket(AF_INET, SOCK_STREAM, 0));
+        if (!s.valid()) return s;
+        int one = 1;
+        setsockopt(s.handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one));
+#ifdef SO_REUSEPORT
+        if (sharePort) setsockopt(s.handle, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+#else
+        (void)sharePort;
+#endif
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+        if (::bind(s.handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(s.handle, 64) != 0) return Socket();
+        return s;
+    }
+
+    Socket accept() const {
+        Handle client = ::accept(handle, nullptr, nullptr);
+        Socket s(client);
+        if (s.valid()) {
+            int one = 1;
+            setsockopt(s.handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+        }
+        return s;
+    }
+
+    uint16_t localPort() const {
+        sockaddr_in address{};
+        socklen_t size = sizeof(address);
+        if (getsockname(handle, reinterpret_cast<sockaddr*>(&address), &size) != 0) return 0;
+        return ntohs(address.sin_port);
+    }
+
+    bool sendAll(const char* data, size_t size) {
+#ifdef MSG_NOSIGNAL
+        constexpr int flags = MSG_NOSIGNAL; // a dropped peer must not raise SIGPIPE
+#else
+        constexpr int flags = 0;
+#endif
+        while (size > 0) {
+            auto sent = ::send(handle, data, static_cast<int>(min<size_t>(size, 1 << 30)), flags);
+            if (sent <= 0) return false;
+            data += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    bool recvAll(char* data, size_t size) {
+        while (size > 0) {
+            auto got = ::recv(handle, data, static_cast<int>(min<size_t>(size, 1 << 30)), 0);
+            if (got <= 0) return false;
+            data += got;
+            size -= static_cast<size_t>(got);
+        }
+        return true;
+    }
+};
+
+// Byte-oriented LZ77 (LZ4-style sequences) for delta batches and baselines.
+// Log records repeat ops, ids and zero bytes, so they shrink well without a dependency.
+class DeltaCodec {
+    static constexpr size_t kMinMatch = 4;
+    static constexpr size_t kHashBits = 14;
+
+    static uint32_t load32(const char* p) {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static void putLength(string& out, size_t length) {
+        for (; length >= 255; length -= 255) out.push_back(static_cast<char>(255));
+        out.push_back(static_cast<char>(length));
+    }
+
+    static bool getLength(const char*& in, const char* end, size_t& length) {
+        while (true) {
+            if (in == end) return false;
+            uint8_t byte = static_cast<uint8_t>(*in++);
+            length += byte;
+            if (byte != 255) return true;
+        }
+    }
+
+    static void emit(string& out, string_view literals, size_t offset, size_t match) {
+        size_t extra = match ? match - kMinMatch : 0;
+        out.push_back(static_cast<char>((min<size_t>(literals.size(), 15) << 4) | min<size_t>(extra, 15)));
+        if (literals.size() >= 15) putLength(out, literals.size() - 15);
+        out.append(literals);
+        if (!match) return;
+        out.push_back(static_cast<char>(offset & 0xFF));
+        out.push_back(static_cast<char>(offset >> 8));
+        if (extra >= 15) putLength(out, extra - 15);
+    }
+
+public:
+    // One input byte decodes to at most 255 output bytes (a length byte of a match).
+    static constexpr size_t kMaxExpansion = 255;
+    static constexpr size_t kMaxRaw = size_t(1) << 30; // largest payload decompress accepts
+
+    static void compress(string_view in, string& out) {
+        out.clear();
+        vector<uint32_t> table(size_t(1) << kHashBits, 0); // position + 1, 0 = empty
+        size_t anchor = 0;
+        size_t i = 0;
+        while (i + kMinMatch <= in.size()) {
+            uint32_t word = load32(in.data() + i);
+            uint32_t& bucket = table[(word * 2654435761u) >> (32 - kHashBits)];
+            size_t candidate = bucket;
+            bucket = static_cast<uint32_t>(i + 1);
+            if (candidate && i - (candidate - 1) <= 0xFFFF && load32(in.data() + candidate - 1) == word) {
+                size_t from = candidate - 1;
+                size_t length = kMinMatch;
+                while (i + length < in.size() && in[from + length] == in[i + length]) ++length;
+                emit(out, in.substr(anchor, i - anchor), i - from, length);
+                i += length;
+                anchor = i;
+                continue;
+            }
+            ++i;
+        }
+        if (anchor < in.size()) emit(out, in.substr(anchor), 0, 0);
+    }
+
+    // Rejects anything that does not decode to exactly rawSize bytes. rawSize comes
+    // from the peer, so it is checked against what `in` could possibly expand to
+    // before anything is allocated.
+    static bool decompress(string_view in, size_t rawSize, string& out) {
+        out.clear();
+        if (rawSize > kMaxRaw || rawSize > (in.size() + 1) * kMaxExpansion) return false;
+        out.reserve(rawSize);
+        const char* p = in.data();
+        const char* end = p + in.size();
+        while (p < end) {
+            uint8_t token = static_cast<uint8_t>(*p++);
+            size_t literals = token >> 4;
+            if (literals == 15 && !getLength(p, end, literals)) return false;
+            if (literals > static_cast<size_t>(end - p) || out.size() + literals > rawSize) return false;
+            out.append(p, literals);
+            p += literals;
+            if (p == end) break;
+
+            if (end - p < 2) return false;
+            size_t offset = static_cast<uint8_t>(p[0]) | static_cast<size_t>(static_cast<uint8_t>(p[1])) << 8;
+            p += 2;
+            size_t match = token & 15;
+            if (match == 15 && !getLength(p, end, match)) return false;
+            match += kMinMatch;
+            if (offset == 0 || offset > out.size() || out.size() + match > rawSize) return false;
+            size_t from = out.size() - offset;
+            for (size_t k = 0; k < match; ++k) out.push_back(out[from + k]); // may overlap itself
+        }
+        return out.size() == rawSize;
+    }
+};
+
+enum class ReplicationFrame : uint8_t {
+    Hello = 1, HelloAck, Baseline, Batch, Ack, QueryStock, StockReply, QueryTotals, TotalsReply
+};
+
+enum class ReplicationAck : uint8_t { Ok = 0, NeedBaseline = 1, Rejected = 2 };
+
+// Little-endian fixed-width fields, shared by the replication and store protocols.
+struct WireFormat {
+    template <typename T>
+    static void put(string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    // Bounds-checked reads from a received frame body.
+    struct Reader {
+        string_view rest;
+
+        template <typename T>
+        bool get(T& value) {
+            if (rest.size() < sizeof(T)) return false;
+            memcpy(&value, rest.data(), sizeof(T));
+            rest.remove_prefix(sizeof(T));
+            return true;
+        }
+    };
+};
+
+struct ReplicationProtocol {
+    static constexpr uint32_t kMaxFrame = 256u << 20;
+
+    static bool sendFrame(Socket& socket, ReplicationFrame type, string_view body) {
+        string header;
+        WireFormat::put<uint32_t>(header, static_cast<uint32_t>(body.size()));
+        WireFormat::put<uint8_t>(header, static_cast<uint8_t>(type));
+        return socket.sendAll(header.data(), header.size()) && socket.sendAll(body.data(), body.size());
+    }
+
+    static bool recvFrame(Socket& socket, ReplicationFrame& type, string& body) {
+        char header[5];
+        if (!socket.recvAll(header, sizeof(header))) return false;
+        uint32_t length;
+        memcpy(&length, header, sizeof(length));
+        if (length > kMaxFrame) return false;
+        type = static_cast<ReplicationFrame>(header[4]);
+        body.resize(length);
+        return socket.recvAll(body.data(), length);
+    }
+
+    // "host:port", or just a port for localhost.
+    static bool parseEndpoint(const string& text, string& host, uint16_t& port) {
+        size_t colon = text.rfind(':');
+        host = colon == string::npos ? "127.0.0.1" : text.substr(0, colon);
+        string_view digits = colon == string::npos ? string_view(text) : string_view(text).substr(colon + 1);
+        unsigned value = 0;
+        auto [end, ec] = from_chars(digits.data(), digits.data() + digits.size(), value);
+        if (ec != errc() || end != digits.data() + digits.size() || value == 0 || value > 0xFFFF) return false;
+        port = static_cast<uint16_t>(value);
+        return !host.empty();
+    }
+};
+
+struct BranchStock {
+    uint32_t branch;
+    int quantity;
+};
+
+struct BranchTotals {
+    uint32_t branch = 0;
+    InventoryTotals totals;
+    uint64_t lastApplied = 0;
+    bool connected = false;
+};
+
+// Renders hub query results; shared by the hub console and --query.
+struct ReplicationReport {
+    static void writeStock(TextWriter& out, int id, span<const BranchStock> rows) {
+        long long total = 0;
+        for (auto& row : rows) total += row.quantity;
+        out << "Product " << id << ": " << total << " unit(s) across " << rows.size() << " branch(es)\n";
+        for (auto& row : rows) out << "  branch " << row.branch << ": " << row.quantity << '\n';
+    }
+
+    static void writeTotals(TextWriter& out, span<const BranchTotals> rows) {
+        out << "=== NETWORK STOCK ===\n";
+        InventoryTotals network;
+        for (auto& row : rows) {
+            out << "Branch " << row.branch << (row.connected ? "" : " (offline)") << " | Products: " << row.totals.skus
+                << " | Units: " << row.totals.units << " | Stock value: ";
+            writeMoney(out, row.totals.stockValue);
+            out << " | Synced to: " << row.lastApplied << '\n';
+            network.skus += row.totals.skus;
+            network.units += row.totals.units;
+            network.stockValue += row.totals.stockValue;
+        }
+        out << "Network | Product rows: " << network.skus << " | Units: " << network.units << " | Stock value: ";
+        writeMoney(out, network.stockValue);
+        out << '\n';
+    }
+};
+
+// Branch side: taps the write-ahead log and ships batches from a worker thread,
+// reconnecting with a fresh baseline whenever the hub cannot continue the stream.
+class ReplicationSender {
+public:
+    struct Status {
+        bool connected = false;
+        uint64_t acked = 0;
+        size_t queuedRecords = 0;
+        size_t baselines = 0;
+    };
+
+private:
+    string host;
+    uint16_t port;
+    uint32_t branch;
+    InventoryPersistence& persistence;
+    chrono::milliseconds batchInterval;
+    size_t batchBytes;
+    size_t queueLimit;
+
+    static constexpr chrono::seconds kHeartbeat{1};
+
+    mutex lock;
+    condition_variable wake;
+    string queued;            // consecutive raw log records, oldest first
+    vector<uint32_t> offsets; // start of each queued record
+    uint64_t firstQueued;     // sequence of the first queued record
+    bool needBaseline = false;
+    bool draining = false; // shutting down: send what is queued without waiting for a full batch
+    bool stopping = false;
+    Socket* active = nullptr; // connection to shut down on stop()/resync()
+    Status status;
+    thread worker;
+
+    void enqueue(uint64_t sequence, string_view record) {
+        lock_guard<mutex> guard(lock);
+        if (offsets.empty()) firstQueued = sequence;
+        if (sequence != firstQueued + offsets.size() || queued.size() + record.size() > queueLimit) {
+            // Cannot continue the stream from memory; the next baseline covers what is dropped.
+            queued.clear();
+            offsets.clear();
+            firstQueued = sequence + 1;
+            needBaseline = true;
+            wake.notify_one();
+            return;
+        }
+        offsets.push_back(static_cast<uint32_t>(queued.size()));
+        queued.append(record);
+        if (queued.size() >= batchBytes) wake.notify_one();
+    }
+
+    // Drops queued records the hub has applied. Caller holds the lock.
+    void trim(uint64_t applied) {
+        if (applied < firstQueued || offsets.empty()) return;
+        size_t drop = min<uint64_t>(applied - firstQueued + 1, offsets.size());
+        size_t bytes = drop < offsets.size() ? offsets[drop] : queued.size();
+        queued.erase(0, bytes);
+        offsets.erase(offsets.begin(), offsets.begin() + static_cast<ptrdiff_t>(drop));
+        for (auto& offset : offsets) offset -= static_cast<uint32_t>(bytes);
+        firstQueued += drop;
+    }
+
+    static bool readAll(const string& path, string& out) {
+        ifstream in(path, ios::binary);
+        if (!in) return false;
+        out.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        return true;
+    }
+
+    bool awaitAck(Socket& socket, uint64_t& applied, ReplicationAck& result) {
+        ReplicationFrame type;
+        string body;
+        uint8_t code = 0;
+        if (!ReplicationProtocol::recvFrame(socket, type, body) || type != ReplicationFrame::Ack) return false;
+        WireFormat::Reader in{body};
+        if (!in.get(code) || !in.get(applied)) return false;
+        result = static_cast<ReplicationAck>(code);
+        return true;
+    }
+
+    bool sendBatch(Socket& socket, uint64_t first, uint32_t count, string_view raw, uint64_t& applied,
+                   ReplicationAck& result) {
+        string body;
+        WireFormat::put<uint64_t>(body, first);
+        WireFormat::put<uint32_t>(body, count);
+        WireFormat::put<uint32_t>(body, static_cast<uint32_t>(raw.size()));
+        string packed;
+        DeltaCodec::compress(raw, packed);
+        body.append(packed);
+        return ReplicationProtocol::sendFrame(socket, ReplicationFrame::Batch, body) && awaitAck(socket, applied, result);
+    }
+
+    // Rebuilds the branch state from its own snapshot and log files: the snapshot
+    // as the baseline, then every logged record after it.
+    bool sendBaseline(Socket& socket, uint64_t& applied) {
+        for (int attempt = 0; attempt < 5; ++attempt) {
+            persistence.log().sync();
+            string snapshot;
+            if (!readAll(persistence.snapshotFile(), snapshot)) {
+                Inventory empty;
+                snapshot = InventorySnapshot(empty).getFileContent();
+            }
+            uint64_t snapshotSequence = 0;
+            if (!InventorySnapshot::readSequence(snapshot, snapshotSequence)) return false;
+
+            string log;
+            WalHeader header{};
+            if (!readAll(persistence.walFile(), log) || log.size() < sizeof(WalHeader)) continue;
+            memcpy(&header, log.data(), sizeof(header));
+            // A checkpoint between the two reads: the log no longer continues this snapshot.
+            if (header.baseSequence > snapshotSequence + 1) continue;
+
+            vector<uint32_t> tail; // offsets of records after the snapshot
+            size_t pos = sizeof(WalHeader);
+            uint64_t sequence = header.baseSequence;
+            WriteAheadLog::Record record;
+            while (size_t size = WriteAheadLog::readRecord(log.data() + pos, log.size() - pos, record)) {
+                if (sequence > snapshotSequence) tail.push_back(static_cast<uint32_t>(pos));
+                ++sequence;
+                pos += size;
+            }
+            tail.push_back(static_cast<uint32_t>(pos));
+
+            string body;
+            WireFormat::put<uint64_t>(body, snapshotSequence);
+            WireFormat::put<uint32_t>(body, static_cast<uint32_t>(snapshot.size()));
+            string packed;
+            DeltaCodec::compress(snapshot, packed);
+            body.append(packed);
+            ReplicationAck result;
+            if (!ReplicationProtocol::sendFrame(socket, ReplicationFrame::Baseline, body) ||
+                !awaitAck(socket, applied, result) || result != ReplicationAck::Ok) return false;
+
+            uint64_t first = snapshotSequence + 1;
+            for (size_t from = 0; from + 1 < tail.size();) {
+                size_t to = from + 1;
+                while (to + 1 < tail.size() && tail[to + 1] - tail[from] <= batchBytes) ++to;
+                string_view raw(log.data() + tail[from], tail[to] - tail[from]);
+                if (!sendBatch(socket, first, static_cast<uint32_t>(to - from), raw, applied, result) ||
+                    result != ReplicationAck::Ok) return false;
+                first += to - from;
+                from = to;
+            }
+            {
+                lock_guard<mutex> guard(lock);
+                ++status.baselines;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    // One connection: handshake, optional baseline, then batches until an error.
+    void serve(Socket& socket) {
+        string hello;
+        WireFormat::put<uint32_t>(hello, branch);
+        ReplicationFrame type;
+        string body;
+        if (!ReplicationProtocol::sendFrame(socket, ReplicationFrame::Hello, hello) ||
+            !ReplicationProtocol::recvFrame(socket, type, body) || type != ReplicationFrame::HelloAck) return;
+        WireFormat::Reader in{body};
+        uint8_t known = 0;
+        uint64_t applied = 0;
+        if (!in.get(known) || !in.get(applied)) return;
+
+        {
+            lock_guard<mutex> guard(lock);
+            uint64_t lastQueued = firstQueued + offsets.size() - 1;
+            if (!known || applied + 1 < firstQueued || applied > lastQueued) needBaseline = true;
+            status.connected = true;
+        }
+
+        auto lastExchange = chrono::steady_clock::now();
+        while (true) {
+            bool baseline;
+            {
+                lock_guard<mutex> guard(lock);
+                baseline = needBaseline;
+                needBaseline = false;
+            }
+            if (baseline && !sendBaseline(socket, applied)) {
+                lock_guard<mutex> guard(lock);
+                needBaseline = true;
+                return;
+            }
+
+            string raw;
+            uint64_t first;
+            uint32_t count;
+            {
+                unique_lock<mutex> guard(lock);
+                trim(applied);
+                status.acked = applied;
+                status.queuedRecords = offsets.size();
+                wake.notify_all(); // a draining destructor waits for the queue to empty
+                wake.wait_for(guard, batchInterval, [&] {
+                    return stopping || needBaseline || queued.size() >= batchBytes || (draining && !offsets.empty());
+                });
+                if (stopping) return;
+                if (needBaseline) continue;
+                // An idle branch still sends an empty batch now and then, which
+                // notices a dropped or restarted hub before the next sale does.
+                if (offsets.empty() && chrono::steady_clock::now() - lastExchange < kHeartbeat) continue;
+                size_t end = offsets.empty() ? 0 : 1;
+                while (end < offsets.size() && offsets[end] <= batchBytes) ++end;
+                size_t bytes = end < offsets.size() ? offsets[end] : queued.size();
+                raw.assign(queued, 0, bytes);
+                first = firstQueued;
+                count = static_cast<uint32_t>(end);
+            }
+
+            ReplicationAck result;
+            if (!sendBatch(socket, first, count, raw, applied, result)) return;
+            lastExchange = chrono::steady_clock::now();
+            if (result == ReplicationAck::NeedBaseline) {
+                lock_guard<mutex> guard(lock);
+                needBaseline = true;
+            } else if (result == ReplicationAck::Rejected) {
+                return;
+            }
+        }
+    }
+
+    void run() {
+        while (true) {
+            {
+                unique_lock<mutex> guard(lock);
+                if (stopping) return;
+            }
+            Socket socket = Socket::connectTo(host, port);
+            if (socket.valid()) {
+                {
+                    lock_guard<mutex> guard(lock);
+                    if (stopping) return;
+                    active = &socket;
+                }
+                serve(socket);
+                lock_guard<mutex> guard(lock);
+                active = nullptr;
+                status.connected = false;
+            }
+            unique_lock<mutex> guard(lock);
+            wake.wait_for(guard, chrono::seconds(1), [&] { return stopping; });
+        }
+    }
+
+public:
+    ReplicationSender(string host, uint16_t port, uint32_t branch, InventoryPersistence& persistence,
+                      chrono::milliseconds batchInterval = chrono::milliseconds(50),
+                      size_t batchBytes = 64 * 1024, size_t queueLimit = 64u << 20)
+        : host(move(host)), port(port), branch(branch), persistence(persistence), batchInterval(batchInterval),
+          batchBytes(batchBytes), queueLimit(queueLimit), firstQueued(persistence.log().lastSequence() + 1) {
+        persistence.log().setTap([this](uint64_t sequence, string_view record) { enqueue(sequence, record); });
+        worker = thread(&ReplicationSender::run, this);
+    }
+
+    ReplicationSender(const ReplicationSender&) = delete;
+    ReplicationSender& operator=(const ReplicationSender&) = delete;
+
+    ~ReplicationSender() {
+        persistence.log().setTap(nullptr);
+        {
+            // Give a connected hub a moment to take the last sales before closing.
+            unique_lock<mutex> guard(lock);
+            draining = true;
+            wake.notify_all();
+            wake.wait_for(guard, chrono::seconds(2), [&] { return offsets.empty() || !status.connected; });
+            stopping = true;
+            if (active) active->shutdownBoth();
+            wake.notify_all();
+        }
+        if (worker.joinable()) worker.join();
+    }
+
+    // For changes that bypass the log (catalog imports): the hub gets a new baseline.
+    void resync() {
+        lock_guard<mutex> guard(lock);
+        needBaseline = true;
+        wake.notify_all();
+    }
+
+    Status currentStatus() {
+        lock_guard<mutex> guard(lock);
+        Status current = status;
+        current.queuedRecords = offsets.size();
+        return current;
+    }
+
+    uint32_t branchId() const { return branch; }
+};
+
+// Headquarters side: one mirror Inventory per branch, fed by the branch's log
+// records and queried for network-wide stock.
+class ReplicationHub {
+    struct Branch {
+        unique_ptr<Inventory> mirror;
+        uint64_t lastApplied = 0;
+        bool connected = false;
+    };
+
+    struct Session {
+        Socket socket;
+        thread worker;
+        atomic<bool> done{false};
+    };
+
+    mutable mutex lock;
+    map<uint32_t, Branch> branches;
+    Socket listener;
+    thread acceptor;
+    mutex sessionLock;
+    vector<unique_ptr<Session>> sessions;
+    atomic<bool> stopping{false};
+
+    static bool reply(Socket& socket, ReplicationAck result, uint64_t applied) {
+        string body;
+        WireFormat::put<uint8_t>(body, static_cast<uint8_t>(result));
+        WireFormat::put<uint64_t>(body, applied);
+        return ReplicationProtocol::sendFrame(socket, ReplicationFrame::Ack, body);
+    }
+
+    ReplicationAck applyBaseline(uint32_t branch, string_view body, uint64_t& applied) {
+        WireFormat::Reader in{body};
+        uint64_t sequence = 0;
+        uint32_t rawSize = 0;
+        string raw;
+        if (!in.get(sequence) || !in.get(rawSize) || !DeltaCodec::decompress(in.rest, rawSize, raw))
+            return ReplicationAck::Rejected;
+        auto mirror = make_unique<Inventory>();
+        mirror->setEventSink(NullInventoryEvents::instance());
+        mirror->setStockLimits(StockLimitTable::unbounded()); // the branch already enforced its own
+        if (!InventorySnapshot::loadBytes(raw, *mirror).ok) return ReplicationAck::Rejected;
+
+        lock_guard<mutex> guard(lock);
+        Branch& state = branches[branch];
+        state.mirror = move(mirror);
+        state.lastApplied = sequence;
+        applied = sequence;
+        return ReplicationAck::Ok;
+    }
+
+    ReplicationAck applyBatch(uint32_t branch, string_view body, uint64_t& applied) {
+        WireFormat::Reader in{body};
+        uint64_t first = 0;
+        uint32_t count = 0, rawSize = 0;
+        string raw;
+        if (!in.get(first) || !in.get(count) || !in.get(rawSize) || !DeltaCodec::decompress(in.rest, rawSize, raw))
+            return ReplicationAck::Rejected;
+
+        lock_guard<mutex> guard(lock);
+        Branch& state = branches[branch];
+        applied = state.lastApplied;
+        if (!state.mirror || first > state.lastApplied + 1) return ReplicationAck::NeedBaseline;
+        size_t pos = 0;
+        WriteAheadLog::Record record;
+        for (uint64_t sequence = first; sequence < first + count; ++sequence) {
+            size_t size = WriteAheadLog::readRecord(raw.data() + pos, raw.size() - pos, record);
+            if (!size) return ReplicationAck::Rejected;
+            pos += size;
+            if (sequence <= state.lastApplied) continue; // already applied: a resend
+            WriteAheadLog::apply(record, *state.mirror);
+            state.lastApplied = sequence;
+        }
+        applied = state.lastApplied;
+        return ReplicationAck::Ok;
+    }
+
+    void setConnected(uint32_t branch, bool connected) {
+        lock_guard<mutex> guard(lock);
+        branches[branch].connected = connected;
+    }
+
+    bool answerQuery(Socket& socket, ReplicationFrame type, string_view body) {
+        string out;
+        if (type == ReplicationFrame::QueryStock) {
+            WireFormat::Reader in{body};
+            int32_t id = 0;
+            if (!in.get(id)) return false;
+            auto rows = stockOf(id);
+            WireFormat::put<uint32_t>(out, static_cast<uint32_t>(rows.size()));
+            for (auto& row : rows) {
+                WireFormat::put<uint32_t>(out, row.branch);
+                WireFormat::put<int32_t>(out, row.quantity);
+            }
+            return ReplicationProtocol::sendFrame(socket, ReplicationFrame::StockReply, out);
+        }
+        auto rows = totals();
+        WireFormat::put<uint32_t>(out, static_cast<uint32_t>(rows.size()));
+        for (auto& row : rows) {
+            WireFormat::put<uint32_t>(out, row.branch);
+            WireFormat::put<uint64_t>(out, row.totals.skus);
+            WireFormat::put<int64_t>(out, row.totals.units);
+            WireFormat::put<int64_t>(out, row.totals.stockValue);
+            WireFormat::put<uint64_t>(out, row.lastApplied);
+            WireFormat::put<uint8_t>(out, row.connected);
+        }
+        return ReplicationProtocol::sendFrame(socket, ReplicationFrame::TotalsReply, out);
+    }
+
+    void serve(Socket& socket) {
+        ReplicationFrame type;
+        string body;
+        optional<uint32_t> branch;
+        while (ReplicationProtocol::recvFrame(socket, type, body)) {
+            uint64_t applied = 0;
+            ReplicationAck result = ReplicationAck::Rejected;
+            if (type == ReplicationFrame::Hello) {
+                WireFormat::Reader in{body};
+                uint32_t id = 0;
+                if (branch || !in.get(id)) break;
+                branch = id;
+                string ack;
+                {
+                    lock_guard<mutex> guard(lock);
+                    Branch& state = branches[id];
+                    state.connected = true;
+                    WireFormat::put<uint8_t>(ack, state.mirror != nullptr);
+                    WireFormat::put<uint64_t>(ack, state.lastApplied);
+                }
+                if (!ReplicationProtocol::sendFrame(socket, ReplicationFrame::HelloAck, ack)) break;
+                continue;
+            }
+            if (type == ReplicationFrame::QueryStock || type == ReplicationFrame::QueryTotals) {
+                if (!answerQuery(socket, type, body)) break;
+                continue;
+            }
+            if (!branch) break;
+            if (type == ReplicationFrame::Baseline) result = applyBaseline(*branch, body, applied);
+            else if (type == ReplicationFrame::Batch) result = applyBatch(*branch, body, applied);
+            if (!reply(socket, result, applied) || result == ReplicationAck::Rejected) break;
+        }
+        if (branch) setConnected(*branch, false);
+    }
+
+    void acceptLoop() {
+        while (!stopping) {
+            Socket client = listener.accept();
+            if (!client.valid()) {
+                if (stopping) return;
+                this_thread::sleep_for(chrono::milliseconds(10));
+                continue;
+            }
+            lock_guard<mutex> guard(sessionLock);
+            // Reap finished sessions before adding one.
+            for (auto it = sessions.begin(); it != sessions.end();) {
+                if ((*it)->done) {
+                    (*it)->worker.join();
+                    it = sessions.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            auto session = make_unique<Session>();
+            session->socket = move(client);
+            Session* s = session.get();
+            session->worker = thread([this, s] {
+                try {
+                    serve(s->socket);
+                } catch (const bad_alloc&) {
+                    // a frame too large to apply: drop this branch, keep the hub
+                }
+                s->done = true;
+            });
+            sessions.push_back(move(session));
+        }
+    }
+
+public:
+    ReplicationHub() = default;
+    ReplicationHub(const ReplicationHub&) = delete;
+    ReplicationHub& operator=(const ReplicationHub&) = delete;
+
+    ~ReplicationHub() {
+        stop();
+    }
+
+    bool start(uint16_t port) {
+        listener = Socket::listenOn(port);
+        if (!listener.valid()) return false;
+        acceptor = thread(&ReplicationHub::acceptLoop, this);
+        return true;
+    }
+
+    uint16_t port() const {
+        return listener.localPort();
+    }
+
+    void stop() {
+        stopping = true;
+        listener.shutdownBoth();
+        if (acceptor.joinable()) acceptor.join();
+        listener.close();
+        lock_guard<mutex> guard(sessionLock);
+        for (auto& session : sessions) session->socket.shutdownBoth();
+        for (auto& session : sessions) session->worker.join();
+        sessions.clear();
+    }
+
+    vector<BranchStock> stockOf(int id) const {
+        vector<BranchStock> rows;
+        lock_guard<mutex> guard(lock);
+        Product found;
+        for (auto& [branch, state] : branches) {
+            if (state.mirror && state.mirror->findProduct(id, found)) rows.push_back({branch, found.quantity});
+        }
+        return rows;
+    }
+
+    vector<BranchTotals> totals() const {
+        vector<BranchTotals> rows;
+        lock_guard<mutex> guard(lock);
+        for (auto& [branch, state] : branches) {
+            if (!state.mirror) continue;
+            rows.push_back({branch, state.mirror->totals(), state.lastApplied, state.connected});
+        }
+        return rows;
+    }
+};
+
+// Headquarters queries against a running hub.
+class ReplicationClient {
+    static bool request(const string& host, uint16_t port, ReplicationFrame type, string_view body,
+                        ReplicationFrame expected, string& out) {
+        Socket socket = Socket::connectTo(host, port);
+        ReplicationFrame got;
+        return socket.valid() && ReplicationProtocol::sendFrame(socket, type, body) &&
+               ReplicationProtocol::recvFrame(socket, got, out) && got == expected;
+    }
+
+public:
+    static bool queryStock(const string& host, uint16_t port, int id, vector<BranchStock>& rows) {
+        string body, reply;
+        WireFormat::put<int32_t>(body, id);
+        if (!request(host, port, ReplicationFrame::QueryStock, body, ReplicationFrame::StockReply, reply)) return false;
+        WireFormat::Reader in{reply};
+        uint32_t count = 0;
+        if (!in.get(count)) return false;
+        rows.clear();
+        for (uint32_t i = 0; i < count; ++i) {
+            BranchStock row{};
+            if (!in.get(row.branch) || !in.get(row.quantity)) return false;
+            rows.push_back(row);
+        }
+        return true;
+    }
+
+    static bool queryTotals(const string& host, uint16_t port, vector<BranchTotals>& rows) {
+        string reply;
+        if (!request(host, port, ReplicationFrame::QueryTotals, {}, ReplicationFrame::TotalsReply, reply)) return false;
+        WireFormat::Reader in{reply};
+        uint32_t count = 0;
+        if (!in.get(count)) return false;
+        rows.clear();
+        for (uint32_t i = 0; i < count; ++i) {
+            BranchTotals row;
+            uint64_t skus = 0;
+            int64_t units = 0;
+            uint8_t connected = 0;
+            if (!in.get(row.branch) || !in.get(skus) || !in.get(units) || !in.get(row.totals.stockValue) ||
+                !in.get(row.lastApplied) || !in.get(connected)) return false;
+            row.totals.skus = skus;
+            row.totals.units = units;
+            row.connected = connected;
+            rows.push_back(row);
+        }
+        return true;
+    }
+};
+
+// --------------------------------------Catalog Import
+/*
+ * Streams a supplier feed or an inventory export into Inventory. Accepted lines:
+ *   CSV:   id,name,quantity,price        (a header row is skipped)
+ *   Text:  id name quantity price        (Product::toFileString / Export Inventory)
+ * Export headers, timestamps and blank lines are ignored.
+ */
+class CatalogImporter {
+public:
+    struct Rejection {
+        size_t line;
+        string reason;
+    };
+
+    struct Report {
+        bool opened = false;
+        size_t rows = 0;
+        size_t accepted = 0;
+        size_t rejected = 0;
+        double seconds = 0.0;
+        vector<Rejection> samples; // first few rejections, for the operator
+
+        double rowsPerSecond() const {
+            return seconds > 0.0 ? rows / seconds : 0.0;
+        }
+    };
+
+    static constexpr size_t chunkSize = 1 << 20;
+    static constexpr size_t maxSamples = 10;
+
+private:
+    struct Row {
+        int id;
+        string_view name;
+        int quantity;
+        double price;
+        uint64_t barcode;
+    };
+
+    static string_view trim(string_view text) {
+        while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) text.remove_prefix(1);
+        while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) text.remove_suffix(1);
+        return text;
+    }
+
+    template <typename T>
+    static bool parseNumber(string_view text, T& out) {
+        text = trim(text);
+        if (text.empty()) return false;
+        auto [end, ec] = from_chars(text.data(), text.data() + text.size(), out);
+        return ec == errc() && end == text.data() + text.size();
+    }
+
+    static bool isSkippable(string_view line) {
+        return line.empty() || line.substr(0, 3) == "===" || line.substr(0, 10) == "Timestamp:";
+    }
+
+    // A header naming a last column "barcode" declares the optional fifth field.
+    static bool declaresBarcode(string_view header) {
+        size_t last = header.rfind(',');
+        if (last == string_view::npos) return false;
+        string_view field = trim(header.substr(last + 1));
+        return field.size() == 7 && equal(field.begin(), field.end(), "barcode",
+                                          [](char a, char b) { return tolower(static_cast<unsigned char>(a)) == b; });
+    }
+
+    // Without a header, a fifth field is taken as a barcode when it is empty or 8 to
+    // 14 digits (names may hold commas, and no price looks like that).
+    static bool looksLikeBarcode(string_view field) {
+        field = trim(field);
+        return field.empty() || (field.size() >= 8 && field.size() <= 14 &&
+                                 all_of(field.begin(), field.end(), [](char c) { return c >= '0' && c <= '9'; }));
+    }
+
+    // Returns an empty reason on success. CSV rows may end in a barcode field: always
+    // when barcodeColumn (declared by the header), otherwise see looksLikeBarcode().
+    // An empty barcode field means none.
+    static const char* parseLine(string_view line, Row& row, bool barcodeColumn) {
+        if (line.find(',') != string_view::npos) {
+            size_t barcodeAt = line.rfind(',');
+            if (count(line.begin(), line.end(), ',') >= 4 &&
+                (barcodeColumn || looksLikeBarcode(line.substr(barcodeAt + 1)))) {
+                string_view field = trim(line.substr(barcodeAt + 1));
+                row.barcode = 0;
+                if (!field.empty() && (!parseNumber(field, row.barcode) || !Barcode::valid(row.barcode)))
+                    return "invalid barcode";
+                line = trim(line.substr(0, barcodeAt));
+            }
+            size_t first = line.find(',');
+            size_t last = line.rfind(',');
+            size_t middle = line.rfind(',', last - 1);
+            if (middle == string_view::npos || middle <= first) return "expected 4 comma-separated fields";
+            if (!parseNumber(line.substr(0, first), row.id)) return "invalid id";
+            row.name = trim(line.substr(first + 1, middle - first - 1));
+            if (!parseNumber(line.substr(middle + 1, last - middle - 1), row.quantity)) return "invalid quantity";
+            if (!parseNumber(line.substr(last + 1), row.price)) return "invalid price";
+        } else {
+            size_t first = line.find(' ');
+            size_t last = line.rfind(' ');
+            size_t middle = last == string_view::npos || last == 0 ? string_view::npos : line.rfind(' ', last - 1);
+            if (middle == string_view::npos || middle <= first) return "expected id, name, quantity and price";
+            if (!parseNumber(line.substr(0, first), row.id)) return "invalid id";
+            row.name = trim(line.substr(first + 1, middle - first - 1));
+            if (!parseNumber(line.substr(middle + 1, last - middle - 1), row.quantity)) return "invalid quantity";
+            if (!parseNumber(line.substr(last + 1), row.price)) return "invalid price";
+        }
+        if (row.name.empty()) return "missing name";
+        if (row.price < 0.0) return "negative price";
+        return "";
+    }
+
+    static const char* describe(InventoryStatus status) {
+        switch (status) {
+            case InventoryStatus::AlreadyExists: return "duplicate product id";
+            case InventoryStatus::InvalidId: return "product id out of range";
+            case InventoryStatus::InvalidQuantity: return "negative quantity";
+            case InventoryStatus::QuantityTooHigh: return "quantity exceeds capacity";
+            case InventoryStatus::InvalidBarcode: return "invalid barcode";
+            case InventoryStatus::DuplicateBarcode: return "duplicate barcode";
+            case InventoryStatus::NameTooLong: return "name too long";
+            default: return "rejected";
+        }
+    }
+
+    static void reject(Report& report, size_t line, const char* reason) {
+        ++report.rejected;
+        if (report.samples.size() < maxSamples) report.samples.push_back({line, reason});
+    }
+
+public:
+    static Report importFile(const string& filepath, Inventory& inventory) {
+        Report report;
+        auto start = chrono::steady_clock::now();
+
+        ifstream in(filepath, ios::binary);
+        if (!in.is_open()) return report;
+        report.opened = true;
+
+        error_code ec;
+        uintmax_t fileSize = filesystem::file_size(filepath, ec);
+
+        vector<char> buffer(chunkSize);
+        string carry;               // partial line left over from the previous chunk
+        vector<pair<size_t, Row>> rows;
+        size_t lineNumber = 0;
+        bool reserved = false;
+        bool headerChecked = false;
+        bool barcodeColumn = false; // the header has a barcode column
+
+        auto processLines = [&](string_view complete) {
+            if (!reserved && !ec && fileSize > 0) {
+                // Extrapolate the row count from the first chunk's average line length.
+                size_t lines = static_cast<size_t>(count(complete.begin(), complete.end(), '\n')) + 1;
+                size_t estimate = static_cast<size_t>(fileSize / max<size_t>(complete.size() / lines, 1));
+                inventory.reserve(inventory.size() + estimate, static_cast<size_t>(fileSize / 2));
+                reserved = true;
+            }
+
+            // Parse the whole chunk first, then validate and insert it as one batch.
+            rows.clear();
+            for (size_t pos = 0; pos < complete.size();) {
+                size_t newline = complete.find('\n', pos);
+                if (newline == string_view::npos) newline = complete.size();
+                string_view line = trim(complete.substr(pos, newline - pos));
+                pos = newline + 1;
+                ++lineNumber;
+
+                if (isSkippable(line)) continue;
+                Row row{};
+                const char* reason = parseLine(line, row, barcodeColumn);
+                bool firstRow = !headerChecked;
+                headerChecked = true;
+                if (*reason) {
+                    // A non-numeric first row is a CSV header, not a bad row.
+                    if (firstRow && strcmp(reason, "invalid id") == 0) {
+                        barcodeColumn = declaresBarcode(line);
+                        continue;
+                    }
+                    ++report.rows;
+                    reject(report, lineNumber, reason);
+                    continue;
+                }
+                rows.emplace_back(lineNumber, row);
+            }
+
+            report.rows += rows.size();
+            for (auto& [number, row] : rows) {
+                InventoryStatus status = inventory.loadProduct(row.id, row.name, row.quantity, row.price, row.barcode);
+                if (status == InventoryStatus::Ok) ++report.accepted;
+                else reject(report, number, describe(status));
+            }
+        };
+
+        while (in) {
+            in.read(buffer.data(), static_cast<streamsize>(buffer.size()));
+            size_t got = static_cast<size_t>(in.gcount());
+            if (got == 0) break;
+
+            string_view chunk(buffer.data(), got);
+            string joined;
+            if (!carry.empty()) {
+                joined = move(carry);
+                joined.append(chunk);
+                chunk = joined;
+            }
+
+            size_t end = chunk.rfind('\n');
+            if (end == string_view::npos) {
+                carry.assign(chunk);
+                continue;
+            }
+            carry.assign(chunk.substr(end + 1));
+            processLines(chunk.substr(0, end + 1));
+        }
+        if (!carry.empty()) processLines(carry);
+
+        sort(report.samples.begin(), report.samples.end(),
+             [](const Rejection& a, const Rejection& b) { return a.line < b.line; });
+
+        report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return report;
+    }
+};
+
+// Build step for SUPERMARKET_STATIC_CATALOG: imports `catalogPath` (CSV with a barcode
+// column) and writes the perfect-hash table for its barcodes to `outPath`.
+inline bool generateBarcodeTable(const string& catalogPath, const string& outPath) {
+    Inventory catalog;
+    auto report = CatalogImporter::importFile(catalogPath, catalog);
+    if (!report.opened) {
+        cerr << " X Cannot open " << catalogPath << ".\n";
+        return false;
+    }
+    for (auto& r : report.samples) cerr << "   line " << r.line << ": " << r.reason << "\n";
+
+    const ProductColumns& cols = catalog.columns();
+    vector<StaticBarcodeTable::Entry> keys;
+    for (uint32_t slot = 0; slot < cols.size(); ++slot) {
+        if (cols.barcodes[slot]) keys.push_back({cols.barcodes[slot], cols.ids[slot]});
+    }
+    StaticBarcodeTable::Built table;
+    if (keys.empty()) {
+        cerr << " X " << catalogPath << " has no barcodes.\n";
+        return false;
+    }
+    if (!StaticBarcodeTable::build(keys, table)) {
+        cerr << " X Cannot build a barcode table from " << catalogPath << ".\n";
+        return false;
+    }
+
+    FileWriter out(outPath);
+    if (!out.isOpen()) {
+        cerr << " X Cannot write " << outPath << ".\n";
+        return false;
+    }
+    StaticBarcodeTable::writeSource(out, table, catalogPath);
+    if (!out.finish()) {
+        cerr << " X Failed to write " << outPath << ".\n";
+        return false;
+    }
+    cerr << "Wrote " << keys.size() << " barcodes (" << report.rejected << " rejected row(s)) to " << outPath << "\n";
+    return true;
+}
+
+// --------------------------------------Restock Planning
+// Reorder points from sales velocity. Each product's daily units over a recent
+// window are smoothed exponentially: the level is the expected daily demand and
+// the one-step forecast errors size the safety stock.
+struct ForecastSettings {
+    int windowDays = 28;
+    double alpha = 0.3;     // weight of the newest day
+    int leadTimeDays = 2;   // order to shelf
+    int coverDays = 7;      // demand a delivery should cover
+    double serviceZ = 1.65; // about 95% of lead times without running out
+};
+
+struct RestockSuggestion {
+    int id = 0;
+    int stock = 0;
+    double dailyDemand = 0.0;
+    int reorderPoint = 0;
+    int amount = 0; // units to order
+};
+
+class RestockPlanner {
+    static constexpr size_t kGrain = 1024; // products per parallel chunk
+
+    struct DaySale {
+        uint32_t row;
+        uint32_t units;
+    };
+
+    static int unitsFor(double demand, double sigma, int days, double z) {
+        return static_cast<int>(ceil(demand * days + z * sigma * sqrt(static_cast<double>(days))));
+    }
+
+public:
+    // Products at or below their reorder point, most urgent (fewest days of stock) first.
+    static vector<RestockSuggestion> plan(const Inventory& inventory, const SalesHistory& history,
+                                          const ForecastSettings& settings = {}) {
+        int32_t today = SalesHistory::today();
+        if (history.rows() == 0 || settings.windowDays < 1) return {};
+        int32_t fromDay = max(today - (settings.windowDays - 1), history.firstDay());
+        if (fromDay > today) return {};
+        size_t days = static_cast<size_t>(today - fromDay + 1);
+
+        const ProductColumns& products = inventory.columns();
+        size_t count = products.size();
+        unordered_map<int, uint32_t> rowOf;
+        rowOf.reserve(count);
+        for (uint32_t row = 0; row < count; ++row) rowOf.emplace(products.ids[row], row);
+
+        // Units sold per day as (row, units) runs sorted by row, one entry per product
+        // sold that day; memory follows the sales, not products x days.
+        vector<vector<DaySale>> sales(days);
+        vector<const SalesPartition*> partitions;
+        history.forDays(fromDay, today, [&](const SalesPartition& p) { partitions.push_back(&p); });
+        Parallel::forRange(partitions.size(), 1, [&](size_t begin, size_t end) {
+            array<int64_t, 4096> ids, units;
+            for (size_t k = begin; k < end; ++k) {
+                const SalesPartition& p = *partitions[k];
+                vector<DaySale>& run = sales[static_cast<size_t>(p.day - fromDay)];
+                for (size_t from = 0; from < p.size(); from += ids.size()) {
+                    size_t chunk = min(ids.size(), p.size() - from);
+                    p.ids.decode(from, chunk, ids.data());
+                    p.units.decode(from, chunk, units.data());
+                    for (size_t i = 0; i < chunk; ++i) {
+                        auto found = rowOf.find(static_cast<int>(ids[i]));
+                        if (found != rowOf.end()) run.push_back({found->second, static_cast<uint32_t>(units[i])});
+                    }
+                }
+                sort(run.begin(), run.end(), [](const DaySale& a, const DaySale& b) { return a.row < b.row; });
+                size_t kept = 0;
+                for (size_t i = 0; i < run.size(); ++i) {
+                    if (kept && run[kept - 1].row == run[i].row) run[kept - 1].units += run[i].units;
+                    else run[kept++] = run[i];
+                }
+                run.resize(kept);
+            }
+        });
+
+        vector<RestockSuggestion> all(count);
+        Parallel::forRange(count, kGrain, [&](size_t begin, size_t end) {
+            vector<size_t> next(days); // per day: first entry not yet consumed
+            for (size_t t = 0; t < days; ++t) {
+                next[t] = static_cast<size_t>(
+                    lower_bound(sales[t].begin(), sales[t].end(), begin,
+                                [](const DaySale& s, size_t row) { return s.row < row; }) - sales[t].begin());
+            }
+            vector<uint32_t> series(days);
+            for (size_t row = begin; row < end; ++row) {
+                bool sold = false;
+                for (size_t t = 0; t < days; ++t) {
+                    const vector<DaySale>& run = sales[t];
+                    series[t] = next[t] < run.size() && run[next[t]].row == row ? run[next[t]++].units : 0;
+                    sold |= series[t] != 0;
+                }
+                if (!sold) continue;
+                double level = series[0];
+                double absError = 0.0;
+                for (size_t t = 1; t < days; ++t) {
+                    double error = series[t] - level;
+                    absError += fabs(error);
+                    level += settings.alpha * error;
+                }
+                if (level <= 0.0) continue;
+                // 1.25 x mean absolute error approximates one standard deviation.
+                double sigma = days > 1 ? 1.25 * absError / static_cast<double>(days - 1) : level;
+                RestockSuggestion& s = all[row];
+                s.id = products.ids[row];
+                s.stock = products.quantities[row];
+                s.dailyDemand = level;
+                s.reorderPoint = unitsFor(level, sigma, settings.leadTimeDays, settings.serviceZ);
+                int capacity = inventory.stockPolicy().capacity(static_cast<uint32_t>(row));
+                int cover = unitsFor(level, sigma, settings.leadTimeDays + settings.coverDays, settings.serviceZ);
+                int target = min(capacity, cover);
+                if (s.stock <= s.reorderPoint && target > s.stock) s.amount = target - s.stock;
+            }
+        });
+
+        vector<RestockSuggestion> plan;
+        for (auto& s : all) {
+            if (s.amount > 0) plan.push_back(s);
+        }
+        sort(plan.begin(), plan.end(), [](const RestockSuggestion& a, const RestockSuggestion& b) {
+            return a.stock / a.dailyDemand < b.stock / b.dailyDemand;
+        });
+        return plan;
+    }
+};
+
+// --------------------------------------Async Export
+// Point-in-time copy of the columns an export renders: ids, quantities and prices
+// are plain vector copies, names are packed into one string (the NameTable and its
+// hash buckets are not copied). Sorting and rendering happen later, off the UI thread.
+class InventoryExportSnapshot : public IPrintable {
+    vector<int> ids;
+    vector<int> quantities;
+    vector<double> prices;
+    vector<uint32_t> nameEnds;
+    string names;
+    string timestamp;
+
+    string_view name(uint32_t slot) const {
+        uint32_t begin = slot ? nameEnds[slot - 1] : 0;
+        return string_view(names).substr(begin, nameEnds[slot] - begin);
+    }
+
+public:
+    // Reuses this snapshot's buffers, so a recycled snapshot does not reallocate.
+    void capture(const Inventory& inventory) {
+        const ProductColumns& rows = inventory.columns();
+        ids = rows.ids;
+        quantities = rows.quantities;
+        prices = rows.prices;
+        nameEnds.clear();
+        names.clear();
+        for (uint32_t slot = 0; slot < rows.size(); ++slot) {
+            names.append(rows.name(slot));
+            nameEnds.push_back(static_cast<uint32_t>(names.size()));
+        }
+        timestamp.assign(TimeTools::timestamp());
+    }
+
+    size_t size() const { return ids.size(); }
+
+    string getFileContent() const override {
+        return renderContent();
+    }
+
+    void writeContent(TextWriter& content) const override {
+        vector<uint32_t> order(ids.size());
+        for (uint32_t slot = 0; slot < order.size(); ++slot) order[slot] = slot;
+        sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return ids[a] < ids[b]; });
+        Inventory::writeExportHeader(content, timestamp);
+        for (uint32_t slot : order) {
+            Product::writeRecord(content, ids[slot], name(slot), quantities[slot], prices[slot]);
+            content << '\n';
+        }
+    }
+};
+
+// One shard's rows as of a snapshot cut; shared by every view that found the
+// shard unchanged since. Rows are kept in pages of ProductColumns::kPageRows
+// slots, and a page no write has touched since the previous image is shared with
+// it, so an image costs a copy of the changed pages only.
+struct ShardImage {
+    struct Page {
+        vector<int> ids;
+        vector<int> quantities;
+        vector<double> prices;
+        vector<uint64_t> barcodes;
+        vector<uint32_t> nameEnds;
+        string names;
+
+        Product row(size_t i) const {
+            uint32_t begin = i ? nameEnds[i - 1] : 0;
+            return Product{ids[i], names.substr(begin, nameEnds[i] - begin), quantities[i], prices[i], barcodes[i]};
+        }
+    };
+
+    vector<shared_ptr<const Page>> pages;
+    size_t rows = 0;
+    InventoryTotals totals;
+
+    // previous is the image the touched pages of `columns` are relative to (null:
+    // copy everything); the caller clears them afterwards.
+    static shared_ptr<const ShardImage> take(const ProductColumns& columns, const InventoryTotals& totals,
+                                             const ShardImage* previous) {
+        auto image = make_shared<ShardImage>();
+        image->rows = columns.size();
+        image->totals = totals;
+        image->pages.resize(columns.pageCount());
+        for (size_t page = 0; page < image->pages.size(); ++page) {
+            if (previous && page < previous->pages.size() && !columns.pageTouched(page)) {
+                image->pages[page] = previous->pages[page];
+                continue;
+            }
+            size_t begin = page * ProductColumns::kPageRows;
+            size_t end = min(begin + ProductColumns::kPageRows, columns.size());
+            auto copy = make_shared<Page>();
+            copy->ids.assign(columns.ids.begin() + begin, columns.ids.begin() + end);
+            copy->quantities.assign(columns.quantities.begin() + begin, columns.quantities.begin() + end);
+            copy->prices.assign(columns.prices.begin() + begin, columns.prices.begin() + end);
+            copy->barcodes.assign(columns.barcodes.begin() + begin, columns.barcodes.begin() + end);
+            copy->nameEnds.reserve(end - begin);
+            for (size_t slot = begin; slot < end; ++slot) {
+                copy->names.append(columns.name(static_cast<uint32_t>(slot)));
+                copy->nameEnds.push_back(static_cast<uint32_t>(copy->names.size()));
+            }
+            image->pages[page] = move(copy);
+        }
+        return image;
+    }
+};
+
+// Consistent point-in-time view of a ConcurrentInventory (see snapshot()). It is
+// immutable, so reports and exports read it on any thread while sales go on, and
+// the shard images are freed with the last view that holds them.
+class InventoryReadView : public IPrintable {
+    vector<shared_ptr<const ShardImage>> images;
+    uint64_t cut;
+    string timestamp;
+
+public:
+    InventoryReadView(vector<shared_ptr<const ShardImage>> images, uint64_t cut)
+        : images(move(images)), cut(cut), timestamp(TimeTools::now_timestamp()) {}
+
+    // Increases with every snapshot taken of the same inventory.
+    uint64_t epoch() const { return cut; }
+
+    size_t size() const {
+        size_t total = 0;
+        for (auto& image : images) total += image->rows;
+        return total;
+    }
+
+    InventoryTotals totals() const {
+        InventoryTotals sum;
+        for (auto& image : images) {
+            sum.skus += image->totals.skus;
+            sum.units += image->totals.units;
+            sum.stockValue += image->totals.stockValue;
+            sum.emptyCount += image->totals.emptyCount;
+            sum.shortCount += image->totals.shortCount;
+        }
+        return sum;
+    }
+
+    vector<Product> sortedProducts() const {
+        vector<Product> all;
+        all.reserve(size());
+        for (auto& image : images) {
+            for (auto& page : image->pages) {
+                for (size_t i = 0; i < page->ids.size(); ++i) all.push_back(page->row(i));
+            }
+        }
+        sort(all.begin(), all.end(), [](const Product& a, const Product& b) { return a.id < b.id; });
+        return all;
+    }
+
+    string getFileContent() const override {
+        return renderContent();
+    }
+
+    void writeContent(TextWriter& content) const override {
+        Inventory::writeExportHeader(content, timestamp);
+        for (auto& p : sortedProducts()) {
+            Product::writeRecord(content, p.id, p.name, p.quantity, p.price);
+            content << '\n';
+        }
+    }
+};
+
+// Writes inventory exports on a worker thread. submit() only captures a snapshot;
+// completion is reported through the returned future, an optional callback (run on
+// the worker), and takeCompleted() for the menus. Two snapshot buffers are recycled,
+// so one can be filled while the other is still being written.
+class AsyncExporter {
+public:
+    struct Result {
+        string path;
+        bool ok = false;
+        size_t products = 0;
+        double millis = 0.0;
+    };
+
+private:
+    struct Job {
+        unique_ptr<InventoryExportSnapshot> snapshot;
+        shared_ptr<const InventoryReadView> view; // instead of a snapshot
+        string path;
+        promise<Result> done;
+        function<void(const Result&)> onDone;
+    };
+
+    static constexpr size_t kSpareBuffers = 2;
+
+    mutex lock;
+    condition_variable wake;
+    deque<Job> jobs;
+    vector<unique_ptr<InventoryExportSnapshot>> spare;
+    vector<Result> completed;
+    bool stopping = false;
+    thread worker;
+
+    future<Result> enqueue(Job job) {
+        future<Result> result = job.done.get_future();
+        {
+            lock_guard<mutex> guard(lock);
+            jobs.push_back(move(job));
+        }
+        wake.notify_one();
+        return result;
+    }
+
+    void run() {
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            wake.wait(guard, [&] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) return; // stopping, and everything queued is written
+            Job job = move(jobs.front());
+            jobs.pop_front();
+            guard.unlock();
+
+            auto start = chrono::steady_clock::now();
+            Result result;
+            result.path = job.path;
+            const IPrintable& source = job.view ? static_cast<const IPrintable&>(*job.view) : *job.snapshot;
+            result.products = job.view ? job.view->size() : job.snapshot->size();
+            result.ok = source.printToFile(job.path);
+            result.millis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            if (job.onDone) job.onDone(result);
+            job.done.set_value(result);
+
+            guard.lock();
+            completed.push_back(result);
+            if (job.snapshot && spare.size() < kSpareBuffers) spare.push_back(move(job.snapshot));
+        }
+    }
+
+public:
+    AsyncExporter() : worker([this] { run(); }) {}
+
+    AsyncExporter(const AsyncExporter&) = delete;
+    AsyncExporter& operator=(const AsyncExporter&) = delete;
+
+    // Finishes every queued export before returning.
+    ~AsyncExporter() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    // Must be called from the thread that owns the inventory; returns once the copy is taken.
+    future<Result> submit(const Inventory& inventory, string path, function<void(const Result&)> onDone = {}) {
+        unique_ptr<InventoryExportSnapshot> snapshot;
+        {
+            lock_guard<mutex> guard(lock);
+            if (!spare.empty()) {
+                snapshot = move(spare.back());
+                spare.pop_back();
+            }
+        }
+        if (!snapshot) snapshot = make_unique<InventoryExportSnapshot>();
+        snapshot->capture(inventory);
+
+        return enqueue(Job{move(snapshot), nullptr, move(path), promise<Result>(), move(onDone)});
+    }
+
+    // Any thread: the view already is a point-in-time copy.
+    future<Result> submit(shared_ptr<const InventoryReadView> view, string path,
+                          function<void(const Result&)> onDone = {}) {
+        return enqueue(Job{nullptr, move(view), move(path), promise<Result>(), move(onDone)});
+    }
+
+    // Exports finished since the last call.
+    vector<Result> takeCompleted() {
+        lock_guard<mutex> guard(lock);
+        vector<Result> finished;
+        finished.swap(completed);
+        return finished;
+    }
+
+    size_t pending() {
+        lock_guard<mutex> guard(lock);
+        return jobs.size();
+    }
+};
+
+// --------------------------------------Metrics
+// Heap allocations made by the current thread. Only the application build installs
+// the counting operator new (see Main); elsewhere the count stays at zero.
+struct AllocationCounter {
+    static inline thread_local uint64_t count = 0;
+};
+
+enum class MetricOp { Insert, Delete, Restock, Sell, SellBatch, Export, Count };
+
+// HDR-style latency histogram in nanoseconds: exact below 16, then 16 linear
+// sub-buckets per power of two (within ~6%). Recording is a few relaxed atomics.
+class LatencyHistogram {
+    static constexpr int kSubBits = 4;
+    static constexpr uint64_t kSub = 1 << kSubBits;
+    static constexpr size_t kBuckets = (64 - kSubBits + 1) * kSub;
+
+    array<atomic<uint64_t>, kBuckets> buckets{};
+    atomic<uint64_t> recorded{0};
+    atomic<uint64_t> sum{0};
+    atomic<uint64_t> maximum{0};
+
+    static size_t bucketOf(uint64_t value) {
+        if (value < kSub) return static_cast<size_t>(value);
+        int shift = 63 - countl_zero(value) - kSubBits;
+        return static_cast<size_t>((shift + 1) * kSub + ((value >> shift) & (kSub - 1)));
+    }
+
+    // Highest value that lands in the bucket, so reported tails never read low.
+    static uint64_t upperEdge(size_t bucket) {
+        if (bucket < kSub) return bucket;
+        int shift = static_cast<int>(bucket / kSub) - 1;
+        uint64_t lower = (kSub | (bucket % kSub)) << shift;
+        return lower + ((uint64_t{1} << shift) - 1);
+    }
+
+public:
+    void record(uint64_t nanos) {
+        buckets[bucketOf(nanos)].fetch_add(1, memory_order_relaxed);
+        recorded.fetch_add(1, memory_order_relaxed);
+        sum.fetch_add(nanos, memory_order_relaxed);
+        uint64_t seen = maximum.load(memory_order_relaxed);
+        while (nanos > seen && !maximum.compare_exchange_weak(seen, nanos, memory_order_relaxed)) {}
+    }
+
+    uint64_t count() const { return recorded.load(memory_order_relaxed); }
+    uint64_t max() const { return maximum.load(memory_order_relaxed); }
+
+    double mean() const {
+        uint64_t n = count();
+        return n ? static_cast<double>(sum.load(memory_order_relaxed)) / n : 0.0;
+    }
+
+    // fraction in [0, 1], e.g. 0.99 for p99.
+    uint64_t percentile(double fraction) const {
+        uint64_t n = count();
+        if (n == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(ceil(fraction * n));
+        uint64_t seen = 0;
+        for (size_t b = 0; b < kBuckets; ++b) {
+            seen += buckets[b].load(memory_order_relaxed);
+            if (seen >= std::max<uint64_t>(rank, 1)) return std::min(upperEdge(b), max());
+        }
+        return max();
+    }
+};
+
+// Per-operation call/failure/allocation counters with a latency histogram each.
+// Safe to record from several threads; printToFile() writes the JSON form.
+class InventoryMetrics : public IPrintable {
+    struct Operation {
+        atomic<uint64_t> failures{0};
+        atomic<uint64_t> allocations{0};
+        LatencyHistogram latency;
+    };
+
+    array<Operation, static_cast<size_t>(MetricOp::Count)> operations;
+
+    struct Quantile {
+        const char* label;
+        double fraction;
+    };
+
+    static constexpr Quantile kQuantiles[] = {{"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}};
+
+public:
+    static const char* name(MetricOp op) {
+        switch (op) {
+            case MetricOp::Insert: return "insert";
+            case MetricOp::Delete: return "delete";
+            case MetricOp::Restock: return "restock";
+            case MetricOp::Sell: return "sell";
+            case MetricOp::SellBatch: return "sell_batch";
+            case MetricOp::Export: return "export";
+            default: return "unknown";
+        }
+    }
+
+    void record(MetricOp op, bool ok, uint64_t nanos, uint64_t allocations = 0) {
+        Operation& o = operations[static_cast<size_t>(op)];
+        if (!ok) o.failures.fetch_add(1, memory_order_relaxed);
+        if (allocations) o.allocations.fetch_add(allocations, memory_order_relaxed);
+        o.latency.record(nanos);
+    }
+
+    const LatencyHistogram& latency(MetricOp op) const {
+        return operations[static_cast<size_t>(op)].latency;
+    }
+
+    // Human-readable dump, one line per operation that has been called.
+    void writeText(TextWriter& out) const {
+        out << "=== METRICS (latency in us) ===\n";
+        bool any = false;
+        for (size_t i = 0; i < operations.size(); ++i) {
+            const Operation& o = operations[i];
+            uint64_t calls = o.latency.count();
+            if (calls == 0) continue;
+            any = true;
+            out << name(static_cast<MetricOp>(i)) << ": " << calls << " call(s), "
+                << o.failures.load(memory_order_relaxed) << " failed | p50 " << o.latency.percentile(0.5) / 1000.0
+                << " | p99 " << o.latency.percentile(0.99) / 1000.0
+                << " | p99.9 " << o.latency.percentile(0.999) / 1000.0
+                << " | max " << o.latency.max() / 1000.0
+                << " | allocs/call " << static_cast<double>(o.allocations.load(memory_order_relaxed)) / calls
+                << '\n';
+        }
+        if (!any) out << "No operations recorded yet.\n";
+    }
+
+    string getFileContent() const override {
+        return renderContent();
+    }
+
+    void writeContent(TextWriter& out) const override {
+        out << "{\n  \"timestamp\": \"" << TimeTools::timestamp() << "\",\n  \"operations\": {";
+        for (size_t i = 0; i < operations.size(); ++i) {
+            const Operation& o = operations[i];
+            out << (i ? ",\n" : "\n") << "    \"" << name(static_cast<MetricOp>(i)) << "\": {"
+                << "\"calls\": " << o.latency.count()
+                << ", \"failures\": " << o.failures.load(memory_order_relaxed)
+                << ", \"allocations\": " << o.allocations.load(memory_order_relaxed)
+                << ", \"latency_ns\": {\"mean\": " << o.latency.mean();
+            for (const Quantile& q : kQuantiles) {
+                out << ", \"" << q.label << "\": " << o.latency.percentile(q.fraction);
+            }
+            out << ", \"max\": " << o.latency.max() << "}}";
+        }
+        out << "\n  }\n}\n";
+    }
+};
+
+// Decorator: times every mutation of the wrapped inventory and counts the heap
+// allocations it made. Metrics off means the menus talk to the inventory directly.
+class MeteredInventory : public ICheckoutOperations {
+    ICheckoutOperations& inner;
+    InventoryMetrics& metrics;
+
+    template <typename Call>
+    bool timed(MetricOp op, Call&& call) {
+        uint64_t allocationsBefore = AllocationCounter::count;
+        uint64_t start = TimeTools::nanos();
+        bool ok = call();
+        metrics.record(op, ok, TimeTools::nanos() - start, AllocationCounter::count - allocationsBefore);
+        return ok;
+    }
+
+public:
+    MeteredInventory(ICheckoutOperations& inner, InventoryMetrics& metrics) : inner(inner), metrics(metrics) {}
+
+    bool insertProduct(const Product& p) override {
+        return timed(MetricOp::Insert, [&] { return inner.insertProduct(p); });
+    }
+
+    bool deleteProduct(int id) override {
+        return timed(MetricOp::Delete, [&] { return inner.deleteProduct(id); });
+    }
+
+    bool restockProduct(int id, int amount) override {
+        return timed(MetricOp::Restock, [&] { return inner.restockProduct(id, amount); });
+    }
+
+    bool sellProduct(int id, int amount, Product& outTaken) override {
+        return timed(MetricOp::Sell, [&] { return inner.sellProduct(id, amount, outTaken); });
+    }
+
+    bool sellProduct(int id, int amount, SaleView& outSold) override {
+        return timed(MetricOp::Sell, [&] { return inner.sellProduct(id, amount, outSold); });
+    }
+
+    bool sellBatch(span<const LineItem> basket, Reciept& receipt) override {
+        return timed(MetricOp::SellBatch, [&] { return inner.sellBatch(basket, receipt); });
+    }
+
+    void showInventory() const override {
+        inner.showInventory();
+    }
+};
+
+// --------------------------------------Concurrent Inventory
+// Serializes a sink that is not thread-safe itself (e.g. the console).
+class SynchronizedInventoryEvents : public IInventoryEvents {
+    IInventoryEvents& inner;
+    mutex lock;
+
+public:
+    explicit SynchronizedInventoryEvents(IInventoryEvents& inner) : inner(inner) {}
+
+    void onEvent(const InventoryEvent& e) override {
+        lock_guard<mutex> guard(lock);
+        inner.onEvent(e);
+    }
+};
+
+enum class StoreOp : uint8_t { Insert = 1, Sell, Restock, Delete, Lookup };
+
+// One request of a batch; `name` points into the caller's buffer.
+struct StoreRequest {
+    StoreOp op{};
+    int id{};
+    int amount{}; // quantity for Insert
+    double price{};
+    uint64_t barcode{};
+    string_view name;
+};
+
+struct StoreReply {
+    InventoryStatus status = InventoryStatus::Ok;
+    int stock = 0;   // stock level after the operation (Lookup: current quantity)
+    Product product; // Lookup only
+};
+
+// Requests and replies of one batch, reused from batch to batch.
+struct StoreBatch {
+    vector<StoreRequest> requests;
+    vector<StoreReply> replies;
+    vector<uint32_t> order; // scratch: request indices grouped by shard
+
+    void clear() { requests.clear(); }
+};
+
+// Products are sharded by ID; each shard is a plain Inventory behind its own mutex,
+// so lanes touching different shards never contend and the stock limits
+// are enforced exactly as in Inventory.
+//
+// Reads that span shards go through snapshot(): a cut taken with every shard
+// locked for an instant, after which each shard is copied either by the reader
+// or, if it gets there first, by the next writer to that shard (copy-on-write of
+// the pre-image). Either way the copy runs under the shard lock, but it only
+// covers the pages written since the shard's previous image (see ShardImage);
+// otherwise a write costs a flag check and marking its page.
+class ConcurrentInventory : public IInventoryOperations, public IPrintable {
+    struct alignas(64) Shard {
+        mutable mutex lock;
+        Inventory inventory;
+        // Snapshot state, guarded by `lock`.
+        uint64_t version = 0;               // bumped by every write
+        shared_ptr<const ShardImage> image; // latest copy, taken at imageVersion
+        uint64_t imageVersion = 0;
+        bool cutPending = false;            // a cut wants this shard as it is now
+
+        explicit Shard(IndexMode mode) : inventory(mode) {}
+
+        void capture() {
+            image = ShardImage::take(inventory.columns(), inventory.totals(), image.get());
+            inventory.clearTouchedPages();
+            imageVersion = version;
+            cutPending = false;
+        }
+
+        bool imageCurrent() const { return image && imageVersion == version; }
+
+        // Before any write: hand a pending cut the state it was taken at.
+        void beforeWrite() {
+            if (cutPending) capture();
+            ++version;
+        }
+    };
+
+    vector<unique_ptr<Shard>> shards;
+    size_t mask;
+    SynchronizedInventoryEvents consoleEvents{ConsoleInventoryEvents::instance()};
+    mutable mutex cutLock; // one snapshot at a time; writers never take it
+    mutable uint64_t cuts = 0;
+
+    size_t shardOf(int id) const {
+        return (static_cast<uint32_t>(id) * 0x9E3779B1u >> 16) & mask;
+    }
+
+    Shard& shardFor(int id) const {
+        return *shards[shardOf(id)];
+    }
+
+public:
+    // shardCount is rounded up to a power of two.
+    explicit ConcurrentInventory(size_t shardCount = 16, IndexMode mode = IndexMode::FlatHash) {
+        size_t count = 1;
+        while (count < shardCount) count *= 2;
+        mask = count - 1;
+        shards.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            shards.push_back(make_unique<Shard>(mode));
+            shards.back()->inventory.setEventSink(consoleEvents);
+        }
+    }
+
+    // The sink is called from every lane concurrently, so it has to be thread-safe
+    // (wrap it in SynchronizedInventoryEvents if it is not).
+    void setEventSink(IInventoryEvents& sink) {
+        for (auto& shard : shards) {
+            lock_guard<mutex> guard(shard->lock);
+            shard->inventory.setEventSink(sink);
+        }
+    }
+
+    // Inventory::setStockLimits on every shard, all or nothing.
+    bool setStockLimits(const StockLimitTable& table, int* overfull = nullptr) {
+        if (!StockPolicy::configurable) return false;
+        vector<unique_lock<mutex>> all;
+        all.reserve(shards.size());
+        for (auto& shard : shards) all.emplace_back(shard->lock);
+        for (auto& shard : shards) {
+            if (!shard->inventory.fitsStockLimits(table, overfull)) return false;
+        }
+        for (auto& shard : shards) {
+            shard->beforeWrite();
+            shard->inventory.setStockLimits(table);
+        }
+        return true;
+    }
+
+    bool insertProduct(const Product& p) override {
+        Shard& shard = shardFor(p.id);
+        lock_guard<mutex> guard(shard.lock);
+        shard.beforeWrite();
+        return shard.inventory.insertProduct(p);
+    }
+
+    bool deleteProduct(int id) override {
+        Shard& shard = shardFor(id);
+        lock_guard<mutex> guard(shard.lock);
+        shard.beforeWrite();
+        return shard.inventory.deleteProduct(id);
+    }
+
+    bool restockProduct(int id, int amount) override {
+        Shard& shard = shardFor(id);
+        lock_guard<mutex> guard(shard.lock);
+        shard.beforeWrite();
+        return shard.inventory.restockProduct(id, amount);
+    }
+
+    bool sellProduct(int id, int amount, Product& outTaken) override {
+        Shard& shard = shardFor(id);
+        lock_guard<mutex> guard(shard.lock);
+        shard.beforeWrite();
+        return shard.inventory.sellProduct(id, amount, outTaken);
+    }
+
+    bool productExists(int id) const {
+        Shard& shard = shardFor(id);
+        lock_guard<mutex> guard(shard.lock);
+        return shard.inventory.productExists(id);
+    }
+
+    bool findProduct(int id, Product& out) const {
+        Shard& shard = shardFor(id);
+        lock_guard<mutex> guard(shard.lock);
+        return shard.inventory.findProduct(id, out);
+    }
+
+    // Applies the whole batch taking each touched shard's lock once. Requests for
+    // the same product run in batch order; every reply carries the outcome.
+    void execute(StoreBatch& batch) {
+        size_t count = batch.requests.size();
+        batch.replies.resize(count);
+        batch.order.resize(count);
+        for (uint32_t i = 0; i < count; ++i) batch.order[i] = i;
+        stable_sort(batch.order.begin(), batch.order.end(), [&](uint32_t a, uint32_t b) {
+            return shardOf(batch.requests[a].id) < shardOf(batch.requests[b].id);
+        });
+
+        OutcomeInventoryEvents outcome;
+        for (size_t from = 0; from < count;) {
+            size_t current = shardOf(batch.requests[batch.order[from]].id);
+            Shard& shard = *shards[current];
+            lock_guard<mutex> guard(shard.lock);
+            Inventory& inventory = shard.inventory;
+            IInventoryEvents& sink = inventory.eventSink();
+            outcome.forwardTo(sink);
+            inventory.setEventSink(outcome);
+            for (; from < count && shardOf(batch.requests[batch.order[from]].id) == current; ++from) {
+                const StoreRequest& request = batch.requests[batch.order[from]];
+                StoreReply& reply = batch.replies[batch.order[from]];
+                SaleView sold;
+                if (request.op != StoreOp::Lookup) shard.beforeWrite();
+                outcome.status = InventoryStatus::Ok;
+                outcome.stock = 0;
+                switch (request.op) {
+                    case StoreOp::Insert:
+                        reply.product.id = request.id;
+                        reply.product.name.assign(request.name);
+                        reply.product.quantity = request.amount;
+                        reply.product.price = request.price;
+                        reply.product.barcode = request.barcode;
+                        inventory.insertProduct(reply.product);
+                        break;
+                    case StoreOp::Sell: inventory.sellProduct(request.id, request.amount, sold); break;
+                    case StoreOp::Restock: inventory.restockProduct(request.id, request.amount); break;
+                    case StoreOp::Delete: inventory.deleteProduct(request.id); break;
+                    case StoreOp::Lookup:
+                        if (inventory.findProduct(request.id, reply.product)) outcome.stock = reply.product.quantity;
+                        else outcome.status = InventoryStatus::NotFound;
+                        break;
+                }
+                reply.status = outcome.status;
+                reply.stock = outcome.stock;
+            }
+            inventory.setEventSink(sink);
+        }
+    }
+
+    // Consistent view of every shard at one instant. Writers wait only for the
+    // cut itself; unchanged shards reuse the image of the previous snapshot.
+    shared_ptr<const InventoryReadView> snapshot() const {
+        lock_guard<mutex> serialize(cutLock);
+        vector<shared_ptr<const ShardImage>> images(shards.size());
+        {
+            vector<unique_lock<mutex>> all;
+            all.reserve(shards.size());
+            for (auto& shard : shards) all.emplace_back(shard->lock);
+            for (size_t i = 0; i < shards.size(); ++i) {
+                if (shards[i]->imageCurrent()) images[i] = shards[i]->image;
+                else shards[i]->cutPending = true;
+            }
+        }
+        for (size_t i = 0; i < shards.size(); ++i) {
+            if (images[i]) continue;
+            Shard& shard = *shards[i];
+            lock_guard<mutex> guard(shard.lock);
+            if (shard.cutPending) shard.capture(); // no write since the cut
+            images[i] = shard.image;
+        }
+        return make_shared<const InventoryReadView>(move(images), ++cuts);
+    }
+
+    // All products, ordered by ID, as of one snapshot.
+    vector<Product> sortedProducts() const {
+        return snapshot()->sortedProducts();
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (auto& shard : shards) {
+            lock_guard<mutex> guard(shard->lock);
+            total += shard->inventory.size();
+        }
+        return total;
+    }
+
+    size_t shardCount() const {
+        return shards.size();
+    }
+
+    void showInventory() const override {
+        vector<Product> all = sortedProducts();
+        StreamWriter out(cout);
+        out << "\n=== INVENTORY STATUS ===\n";
+        if (all.empty()) {
+            out << "No products.\n";
+            return;
+        }
+        for (auto& p : all) {
+            Product::writeDisplay(out, p.id, p.name, p.quantity, p.price);
+            out << '\n';
+        }
+    }
+
+    string getFileContent() const override {
+        return renderContent();
+    }
+
+    void writeContent(TextWriter& content) const override {
+        snapshot()->writeContent(content);
+    }
+};
+
+// --------------------------------------Inventory Service
+/*
+ * Network access to a ConcurrentInventory for POS terminals (--serve port).
+ * Little-endian binary frames; a client may send any number of requests before
+ * reading, and replies come back in request order with the request's tag:
+ *   request = [u32 body length][u8 StoreOp][u32 tag][fields]
+ *     Insert         {i32 id, i32 quantity, f64 price, u64 barcode, u16 name length, name}
+ *     Sell / Restock {i32 id, i32 amount}
+ *     Delete, Lookup {i32 id}
+ *   reply   = [u32 body length][u8 InventoryStatus][u32 tag][i32 stock]
+ *             (+ Lookup found: f64 price, u64 barcode, u16 name length, name)
+ */
+struct StoreProtocol {
+    static constexpr uint32_t kMaxBody = 4096;
+    static constexpr size_t kMalformed = string::npos;
+
+    static void writeRequest(string& out, uint32_t tag, const StoreRequest& request) {
+        size_t start = out.size();
+        WireFormat::put<uint32_t>(out, 0);
+        WireFormat::put<uint8_t>(out, static_cast<uint8_t>(request.op));
+        WireFormat::put<uint32_t>(out, tag);
+        WireFormat::put<int32_t>(out, request.id);
+        if (request.op == StoreOp::Insert || request.op == StoreOp::Sell || request.op == StoreOp::Restock)
+            WireFormat::put<int32_t>(out, request.amount);
+        if (request.op == StoreOp::Insert) {
+            WireFormat::put<double>(out, request.price);
+            WireFormat::put<uint64_t>(out, request.barcode);
+            WireFormat::put<uint16_t>(out, static_cast<uint16_t>(request.name.size()));
+            out.append(request.name);
+        }
+        uint32_t length = static_cast<uint32_t>(out.size() - start - sizeof(uint32_t));
+        memcpy(out.data() + start, &length, sizeof(length));
+    }
+
+    // Bytes used by one request at the front of `data`: 0 while incomplete,
+    // kMalformed for anything a client should never send.
+    static size_t readRequest(string_view data, uint32_t& tag, StoreRequest& out) {
+        uint32_t length;
+        if (data.size() < sizeof(length)) return 0;
+        memcpy(&length, data.data(), sizeof(length));
+        if (length > kMaxBody) return kMalformed;
+        if (data.size() < sizeof(length) + length) return 0;
+        WireFormat::Reader in{data.substr(sizeof(length), length)};
+        uint8_t op = 0;
+        if (!in.get(op) || !in.get(tag) || !in.get(out.id)) return kMalformed;
+        out.op = static_cast<StoreOp>(op);
+        switch (out.op) {
+            case StoreOp::Insert: {
+                uint16_t nameLength = 0;
+                if (!in.get(out.amount) || !in.get(out.price) || !in.get(out.barcode) || !in.get(nameLength) ||
+                    in.rest.size() != nameLength) return kMalformed;
+                out.name = in.rest;
+                return sizeof(length) + length;
+            }
+            case StoreOp::Sell:
+            case StoreOp::Restock:
+                if (!in.get(out.amount)) return kMalformed;
+                break;
+            case StoreOp::Delete:
+            case StoreOp::Lookup: break;
+            default: return kMalformed;
+        }
+        return in.rest.empty() ? sizeof(length) + length : kMalformed;
+    }
+
+    static void writeReply(string& out, uint32_t tag, StoreOp op, const StoreReply& reply) {
+        size_t start = out.size();
+        WireFormat::put<uint32_t>(out, 0);
+        WireFormat::put<uint8_t>(out, static_cast<uint8_t>(reply.status));
+        WireFormat::put<uint32_t>(out, tag);
+        WireFormat::put<int32_t>(out, reply.stock);
+        if (op == StoreOp::Lookup && reply.status == InventoryStatus::Ok) {
+            WireFormat::put<double>(out, reply.product.price);
+            WireFormat::put<uint64_t>(out, reply.product.barcode);
+            WireFormat::put<uint16_t>(out, static_cast<uint16_t>(reply.product.name.size()));
+            out.append(reply.product.name);
+        }
+        uint32_t length = static_cast<uint32_t>(out.size() - start - sizeof(uint32_t));
+        memcpy(out.data() + start, &length, sizeof(length));
+    }
+
+    // Parses a reply body (without the length prefix).
+    static bool readReply(string_view body, uint32_t& tag, StoreReply& out) {
+        WireFormat::Reader in{body};
+        uint8_t status = 0;
+        if (!in.get(status) || !in.get(tag) || !in.get(out.stock)) return false;
+        out.status = static_cast<InventoryStatus>(status);
+        if (in.rest.empty()) return true;
+        uint16_t nameLength = 0;
+        if (!in.get(out.product.price) || !in.get(out.product.barcode) || !in.get(nameLength) ||
+            in.rest.size() != nameLength) return false;
+        out.product.name.assign(in.rest);
+        out.product.quantity = out.stock;
+        return true;
+    }
+};
+
+// Blocking client for terminals and tools: sends a whole batch of requests
+// pipelined, then reads the replies.
+class InventoryClient {
+    Socket socket;
+    string outgoing;
+    string body;
+    uint32_t nextTag = 1;
+
+public:
+    bool connect(const string& host, uint16_t port) {
+        socket = Socket::connectTo(host, port);
+        return socket.valid();
+    }
+
+    bool connected() const { return socket.valid(); }
+
+    bool call(span<const StoreRequest> requests, vector<StoreReply>& replies) {
+        outgoing.clear();
+        uint32_t firstTag = nextTag;
+        for (auto& request : requests) StoreProtocol::writeRequest(outgoing, nextTag++, request);
+        if (!socket.sendAll(outgoing.data(), outgoing.size())) return false;
+        replies.resize(requests.size());
+        for (size_t i = 0; i < requests.size(); ++i) {
+            uint32_t length = 0, tag = 0;
+            if (!socket.recvAll(reinterpret_cast<char*>(&length), sizeof(length)) || length > (1u << 20)) return false;
+            body.resize(length);
+            if (!socket.recvAll(body.data(), length)) return false;
+            replies[i].product.id = requests[i].id;
+            if (!StoreProtocol::readReply(body, tag, replies[i]) || tag != firstTag + i) return false;
+        }
+        return true;
+    }
+
+    bool call(const StoreRequest& request, StoreReply& reply) {
+        vector<StoreReply> replies;
+        if (!call(span<const StoreRequest>(&request, 1), replies)) return false;
+        reply = move(replies[0]);
+        return true;
+    }
+};
+
+#ifdef __linux__
+// Event-loop server: each thread owns an epoll set and its own listening socket
+// on the shared port. One pass reads every readable connection, runs all
+// complete requests as one StoreBatch, makes logged changes durable with a
+// single log sync, then writes the replies.
+class InventoryServer {
+public:
+    struct Stats {
+        uint64_t requests = 0;
+        uint64_t batches = 0;
+        uint64_t connections = 0; // accepted so far
+    };
+
+private:
+    static constexpr size_t kReadChunk = 64 * 1024;
+    static constexpr size_t kMaxBuffered = 4u << 20; // per direction; a client that does not read its replies is paused
+    static constexpr int kEvents = 256;
+
+    struct Connection {
+        Socket socket;
+        string in;
+        string out;
+        size_t sent = 0;
+        uint32_t interest = 0;
+        bool closing = false; // peer closed or sent garbage: finish replies, then drop
+
+        size_t pendingOut() const { return out.size() - sent; }
+    };
+
+    struct Worker {
+        Socket listener;
+        int epoll = -1;
+        int wake = -1;
+        thread loop;
+
+        ~Worker() {
+            if (epoll >= 0) ::close(epoll);
+            if (wake >= 0) ::close(wake);
+        }
+    };
+
+    ConcurrentInventory& inventory;
+    WriteAheadLog* log;
+    vector<unique_ptr<Worker>> workers;
+    uint16_t boundPort = 0;
+    atomic<bool> stopping{false};
+    atomic<bool> logFailed{false}; // reported once
+    atomic<uint64_t> requestCount{0}, batchCount{0}, connectionCount{0};
+
+    static void watch(int epoll, int fd, uint32_t events, int op) {
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = fd;
+        epoll_ctl(epoll, op, fd, &event);
+    }
+
+    void acceptAll(Worker& worker, map<int, unique_ptr<Connection>>& open) {
+        while (true) {
+            Socket client = worker.listener.accept();
+            if (!client.valid()) return;
+            if (!client.setNonBlocking()) continue;
+            auto connection = make_unique<Connection>();
+            connection->interest = EPOLLIN | EPOLLRDHUP;
+            int fd = client.native();
+            connection->socket = move(client);
+            watch(worker.epoll, fd, connection->interest, EPOLL_CTL_ADD);
+            open[fd] = move(connection);
+            ++connectionCount;
+        }
+    }
+
+    static void fill(Connection& c, span<char> chunk) {
+        while (c.in.size() < kMaxBuffered) {
+            ssize_t got = ::recv(c.socket.native(), chunk.data(), chunk.size(), 0);
+            if (got > 0) {
+                c.in.append(chunk.data(), static_cast<size_t>(got));
+                continue;
+            }
+            if (got < 0 && errno == EINTR) continue;
+            if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) c.closing = true;
+            return;
+        }
     }
 
-    void showInventory() const override {
-        cout << "\n=== INVENTORY STATUS ===\n";
-        if (products.empty()) {
-            cout << "No products.\n";
+    static void flush(Connection& c) {
+        while (c.pendingOut() > 0) {
+            ssize_t sent = ::send(c.socket.native(), c.out.data() + c.sent, c.pendingOut(), MSG_NOSIGNAL);
+            if (sent > 0) {
+                c.sent += static_cast<size_t>(sent);
+                continue;
+            }
+            if (sent < 0 && errno == EINTR) continue;
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            c.closing = true;
+            c.out.clear();
+            c.sent = 0;
             return;
         }
-        for (auto& [id, p] : products) {
-            cout << p.toString() << '\n';
+        if (c.sent == c.out.size()) {
+            c.out.clear();
+            c.sent = 0;
         }
     }
 
-    string getFileContent() const override {
-        stringstream content;
-        content << "=== INVENTORY EXPORT ===\n";
-        content << "Timestamp: " << TimeTools::now_timestamp() << "\n\n";
-        for (auto& [id, p] : products) {
-            content << p.toFileString() << "\n";
-        }
-        return content.str();
-    }
+    void run(Worker& worker) {
+        map<int, unique_ptr<Connection>> open;
+        StoreBatch batch;
+        vector<uint32_t> tags;
+        vector<Connection*> owners; // connection of each batched request
+        vector<Connection*> ready;
+        vector<size_t> consumed;    // parsed input bytes per ready connection
+        vector<char> chunk(kReadChunk);
+        epoll_event events[kEvents];
 
-    bool productExists(int id) const {
-        return products.count(id) > 0;
-    }
-};
+        while (!stopping) {
+            int n = epoll_wait(worker.epoll, events, kEvents, -1);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            ready.clear();
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == worker.wake) continue;
+                if (fd == worker.listener.native()) {
+                    acceptAll(worker, open);
+                    continue;
+                }
+                auto found = open.find(fd);
+                if (found == open.end()) continue;
+                Connection& c = *found->second;
+                if (events[i].events & EPOLLOUT) flush(c);
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) fill(c, chunk);
+                ready.push_back(&c);
+            }
 
-// --------------------------------------Reciept
-class Reciept : public IPrintable {
-    vector<Product> soldItems;
-    double total = 0.0;
+            batch.clear();
+            tags.clear();
+            owners.clear();
+            consumed.assign(ready.size(), 0);
+            for (size_t r = 0; r < ready.size(); ++r) {
+                Connection& c = *ready[r];
+                string_view input(c.in);
+                size_t& pos = consumed[r];
+                while (c.pendingOut() < kMaxBuffered) {
+                    uint32_t tag = 0;
+                    StoreRequest request;
+                    size_t used = StoreProtocol::readRequest(input.substr(pos), tag, request);
+                    if (used == StoreProtocol::kMalformed) {
+                        c.closing = true;
+                        c.in.clear(); // nothing after garbage is trusted
+                        break;
+                    }
+                    if (used == 0) break;
+                    pos += used;
+                    batch.requests.push_back(request);
+                    tags.push_back(tag);
+                    owners.push_back(&c);
+                }
+            }
+
+            if (!batch.requests.empty()) {
+                inventory.execute(batch);
+                bool mutated = any_of(batch.requests.begin(), batch.requests.end(),
+                                      [](const StoreRequest& r) { return r.op != StoreOp::Lookup; });
+                if (log && mutated && !log->sync() && !logFailed.exchange(true)) { // replies promise durability
+                    cerr << " X Write-ahead log failed; changes will not survive a crash\n";
+                }
+                for (size_t i = 0; i < batch.requests.size(); ++i) {
+                    StoreProtocol::writeReply(owners[i]->out, tags[i], batch.requests[i].op, batch.replies[i]);
+                }
+                requestCount += batch.requests.size();
+                ++batchCount;
+            }
+
+            for (size_t r = 0; r < ready.size(); ++r) {
+                Connection& c = *ready[r];
+                c.in.erase(0, min(consumed[r], c.in.size()));
+                flush(c);
+                int fd = c.socket.native();
+                if (c.closing && c.pendingOut() == 0) {
+                    epoll_ctl(worker.epoll, EPOLL_CTL_DEL, fd, nullptr);
+                    open.erase(fd);
+                    continue;
+                }
+                uint32_t interest = c.pendingOut() ? uint32_t(EPOLLOUT) : 0u;
+                if (!c.closing && c.pendingOut() < kMaxBuffered) interest |= EPOLLIN | EPOLLRDHUP;
+                if (interest != c.interest) {
+                    c.interest = interest;
+                    watch(worker.epoll, fd, interest, EPOLL_CTL_MOD);
+                }
+            }
+        }
+    }
 
 public:
-    void addItem(const string& name, int qty, double price) {
-        Product p;
-        p.name = name;
-        p.quantity = qty;
-        p.price = price;
-        soldItems.push_back(p);
-        total += price * qty;
+    InventoryServer(ConcurrentInventory& inventory, WriteAheadLog* log = nullptr) : inventory(inventory), log(log) {}
+    InventoryServer(const InventoryServer&) = delete;
+    InventoryServer& operator=(const InventoryServer&) = delete;
+
+    ~InventoryServer() {
+        stop();
     }
 
-    string getFileContent() const override {
-        stringstream content;
-        content << "===== RECEIPT =====\n";
-        content << "Timestamp: " << TimeTools::now_timestamp() << "\n";
-        content << "-------------------\n";
-        for (auto& p : soldItems) {
-            content << p.name << " x" << p.quantity << " @ " << p.price
-                   << " = " << (p.quantity * p.price) << "\n";
+    // Port 0 picks a free port (see port()).
+    bool start(uint16_t port, size_t threads) {
+        for (size_t i = 0; i < max<size_t>(threads, 1); ++i) {
+            auto worker = make_unique<Worker>();
+            worker->listener = Socket::listenOn(i == 0 ? port : boundPort, true);
+            if (!worker->listener.valid() || !worker->listener.setNonBlocking()) break;
+            if (i == 0) boundPort = worker->listener.localPort();
+            worker->epoll = epoll_create1(EPOLL_CLOEXEC);
+            worker->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (worker->epoll < 0 || worker->wake < 0) break;
+            watch(worker->epoll, worker->listener.native(), EPOLLIN, EPOLL_CTL_ADD);
+            watch(worker->epoll, worker->wake, EPOLLIN, EPOLL_CTL_ADD);
+            workers.push_back(move(worker));
         }
-        content << "-------------------\n";
-        content << "Total: " << total << "\n";
-        content << "===================\n";
-        return content.str();
+        if (workers.size() != max<size_t>(threads, 1)) {
+            workers.clear();
+            return false;
+        }
+        for (auto& worker : workers) worker->loop = thread(&InventoryServer::run, this, ref(*worker));
+        return true;
     }
 
-    void clear() {
-        soldItems.clear();
-        total = 0.0;
+    uint16_t port() const {
+        return boundPort;
     }
 
-    bool isEmpty() const {
-        return soldItems.empty();
+    void stop() {
+        stopping = true;
+        for (auto& worker : workers) {
+            uint64_t one = 1;
+            [[maybe_unused]] auto written = ::write(worker->wake, &one, sizeof(one));
+        }
+        for (auto& worker : workers) {
+            if (worker->loop.joinable()) worker->loop.join();
+        }
+        workers.clear();
+    }
+
+    Stats stats() const {
+        return Stats{requestCount.load(), batchCount.load(), connectionCount.load()};
     }
 };
+#endif
 
 // --------------------------------------Handling the input
+// Thrown when input ends (end of a script, or Ctrl+D / Ctrl+Z at the console).
+class InputClosed : public runtime_error {
+public:
+    InputClosed() : runtime_error("input closed") {}
+};
+
 class InputHandler {
 public:
     static int getIntInput(const string& prompt) {
@@ -377,6 +6858,7 @@ public:
         while (true) {
             cout << prompt;
             cin >> value;
+            if (cin.fail() && cin.eof()) throw InputClosed();
             if (cin.fail()) {
                 cin.clear();
                 ScreenManager::clearInputBuffer();
@@ -393,6 +6875,7 @@ public:
         while (true) {
             cout << prompt;
             cin >> value;
+            if (cin.fail() && cin.eof()) throw InputClosed();
             if (cin.fail()) {
                 cin.clear();
                 ScreenManager::clearInputBuffer();
@@ -404,6 +6887,23 @@ public:
         }
     }
 
+    static uint64_t getBarcodeInput(const string& prompt) {
+        uint64_t value;
+        while (true) {
+            cout << prompt;
+            cin >> value;
+            if (cin.fail() && cin.eof()) throw InputClosed();
+            if (cin.fail()) {
+                cin.clear();
+                ScreenManager::clearInputBuffer();
+                cout << " X Invalid input. Please enter the digits of the barcode.\n";
+            } else {
+                ScreenManager::clearInputBuffer();
+                return value;
+            }
+        }
+    }
+
     static string getStringInput(const string& prompt) {
         string value;
         cout << prompt;
@@ -418,18 +6918,140 @@ public:
         getline(cin, p.name);
         p.quantity = getIntInput("Enter quantity: ");
         p.price = getDoubleInput("Enter price: ");
+        p.barcode = getBarcodeInput("Enter barcode (0 for none): ");
         return p;
     }
+
+    static vector<LineItem> getBasketInput() {
+        vector<LineItem> basket;
+        while (true) {
+            LineItem line;
+            line.id = getIntInput("Enter product ID (0 to finish): ");
+            if (line.id == 0) break;
+            line.quantity = getIntInput("Enter quantity to sell: ");
+            basket.push_back(line);
+        }
+        return basket;
+    }
 };
 
 // --------------------------------------Main Menu
+// Everything a role menu works with. Mutations go through `operations`, which is
+// the inventory itself or a MeteredInventory in front of it.
+struct MenuContext {
+    Inventory& inventory;
+    ICheckoutOperations& operations;
+    ReceiptSessions& receipts;
+    InventoryPersistence& persistence;
+    SalesLedger& ledger;
+    SalesHistory& history;
+    AsyncExporter& exporter;
+    PricingEngine& promotions;
+    StockLimitTable& stockLimits;
+    InventoryMetrics* metrics; // null when metrics are off
+    ReplicationSender* replication; // null when the branch does not replicate
+};
+
 class MainMenu {
 protected:
     Inventory& inventory;
-    Reciept& receipt;
+    ICheckoutOperations& operations;
+    ReceiptSessions& receipts;
+    int lane = 0; // checkout lane whose receipt this menu fills
+    InventoryPersistence& persistence;
+    SalesLedger& ledger;
+    SalesHistory& history;
+    AsyncExporter& exporter;
+    PricingEngine& promotions;
+    StockLimitTable& stockLimits;
+    InventoryMetrics* metrics;
+    ReplicationSender* replication;
+
+    static constexpr size_t kPageSize = 20;
+
+    // Starts a background inventory export; the result shows up in reportExports().
+    void exportInventory() {
+        string filename = TimeTools::uniqueFileName("inventory_", ".txt");
+        InventoryMetrics* sink = metrics;
+        exporter.submit(inventory, filename, [sink](const AsyncExporter::Result& done) {
+            if (sink) sink->record(MetricOp::Export, done.ok, static_cast<uint64_t>(done.millis * 1e6));
+        });
+        cout << "Exporting inventory to " << filename << " in the background...\n";
+    }
+
+    // Exports the lane's receipt and books its priced total in the session ledger.
+    bool finishReceipt(const string& filepath) {
+        Cents total = receipts.current(lane).totalCents();
+        if (!receipts.finish(lane, filepath)) return false;
+        ledger.recordReceipt(total);
+        return true;
+    }
+
+    // Prints exports that finished since the menu was last drawn.
+    void reportExports() {
+        for (auto& done : exporter.takeCompleted()) {
+            if (done.ok) {
+                cout << "Inventory exported to " << done.path << " (" << done.products << " products, "
+                     << done.millis << " ms) :D\n";
+            } else {
+                cout << " X Failed to export inventory to " << done.path << ".\n";
+            }
+        }
+    }
+
+    // Shared Show Inventory screen: optional filter, then one page per buffered write.
+    void browseInventory() {
+        cout << "=== SHOW INVENTORY ===\n";
+        cout << "1. All Products\n2. ID Range\n3. Low Stock\n4. Name Prefix\n";
+        InventoryFilter filter;
+        switch (InputHandler::getIntInput("Filter: ")) {
+            case 2:
+                filter.minId = InputHandler::getIntInput("From ID: ");
+                filter.maxId = InputHandler::getIntInput("To ID: ");
+                break;
+            case 3: filter.belowQuantity = InputHandler::getIntInput("Show stock below: "); break;
+            case 4: filter.namePrefix = InputHandler::getStringInput("Name starts with: "); break;
+            default: break;
+        }
+
+        int cursor = filter.minId;
+        for (size_t pageNumber = 1;; ++pageNumber) {
+            InventoryPage page;
+            {
+                StreamWriter out(cout);
+                out << "\n=== INVENTORY STATUS (page " << pageNumber << ") ===\n";
+                page = inventory.writePage(out, filter, cursor, kPageSize);
+                if (page.shown == 0) out << "No products.\n";
+            }
+            if (!page.more || InputHandler::getIntInput("1 = next page, 0 = stop: ") != 1) break;
+            cursor = page.nextCursor;
+        }
+    }
+
+    // Scan-to-sell: the barcode replaces the typed product ID.
+    void scanBarcode() {
+        cout << "=== SCAN BARCODE ===\n";
+        uint64_t code = InputHandler::getBarcodeInput("Scan barcode: ");
+        int id = 0;
+        if (!inventory.resolveBarcode(code, id)) {
+            cout << " X Unknown barcode " << code << ".\n";
+            return;
+        }
+        NameIndex::Match match{id, 0};
+        inventory.showProducts(span<const NameIndex::Match>(&match, 1));
+        int amount = InputHandler::getIntInput("Enter quantity to sell: ");
+        SaleView sold;
+        if (operations.sellProduct(id, amount, sold)) {
+            receipts.current(lane).addItem(sold);
+        }
+    }
 
 public:
-    MainMenu(Inventory& inv, Reciept& rec) : inventory(inv), receipt(rec) {}
+    explicit MainMenu(const MenuContext& app)
+        : inventory(app.inventory), operations(app.operations), receipts(app.receipts),
+          persistence(app.persistence), ledger(app.ledger), history(app.history), exporter(app.exporter),
+          promotions(app.promotions), stockLimits(app.stockLimits),
+          metrics(app.metrics), replication(app.replication) {}
     virtual ~MainMenu() = default;
     virtual void show() = 0;
 };
@@ -437,19 +7059,22 @@ public:
 // --------------------------------------Roles
 class AdminMenu : public MainMenu {
 public:
-    AdminMenu(Inventory& inv, Reciept& rec) : MainMenu(inv, rec) {}
+    explicit AdminMenu(const MenuContext& app) : MainMenu(app) {}
 
     void show() override {
         while (true) {
             ScreenManager::clearScreen();
+            reportExports();
             cout << "\n=== ADMIN MENU ===\n";
             cout << "1. Insert Product\n2. Delete Product\n3. Restock\n4. Sell\n";
-            cout << "5. Show Inventory\n6. Export Inventory\n7. Export Receipt\n8. Back\n";
+            cout << "5. Show Inventory\n6. Export Inventory\n7. Export Receipt\n8. Sell Basket\n";
+            cout << "9. Save Snapshot\n10. Import Catalog\n11. Search Products\n12. Dashboard\n";
+            cout << "13. Metrics\n14. Scan Barcode\n15. Promotions\n16. Sales Reports\n17. Stock Limits\n18. Back\n";
             cout << "Choice: ";
 
             int choice = InputHandler::getIntInput("");
 
-            if (choice == 8) break;
+            if (choice == 18) break;
 
             processChoice(choice);
         }
@@ -463,9 +7088,19 @@ private:
             case 2: deleteProduct(); break;
             case 3: restockProduct(); break;
             case 4: sellProduct(); break;
-            case 5: showInventory(); break;
+            case 5: browseInventory(); break;
             case 6: exportInventory(); break;
             case 7: exportReceipt(); break;
+            case 8: sellBasket(); break;
+            case 9: saveSnapshot(); break;
+            case 10: importCatalog(); break;
+            case 11: searchProducts(); break;
+            case 12: showDashboard(); break;
+            case 13: showMetrics(); break;
+            case 14: scanBarcode(); break;
+            case 15: editPromotions(); break;
+            case 16: salesReports(); break;
+            case 17: editStockLimits(); break;
             default: cout << " X Invalid choice.\n"; break;
         }
         ScreenManager::pauseForUser();
@@ -474,52 +7109,297 @@ private:
     void insertProduct() {
         cout << "=== INSERT PRODUCT ===\n";
         Product p = InputHandler::getProductInput();
-        inventory.insertProduct(p);
+        operations.insertProduct(p);
     }
 
     void deleteProduct() {
         cout << "=== DELETE PRODUCT ===\n";
         int id = InputHandler::getIntInput("Enter product ID to delete: ");
-        inventory.deleteProduct(id);
+        operations.deleteProduct(id);
     }
 
     void restockProduct() {
         cout << "=== RESTOCK PRODUCT ===\n";
         int id = InputHandler::getIntInput("Enter product ID: ");
         int amount = InputHandler::getIntInput("Enter amount to restock: ");
-        inventory.restockProduct(id, amount);
+        operations.restockProduct(id, amount);
     }
 
     void sellProduct() {
         cout << "=== SELL PRODUCT ===\n";
         int id = InputHandler::getIntInput("Enter product ID: ");
         int amount = InputHandler::getIntInput("Enter quantity to sell: ");
-        Product sold;
-        if (inventory.sellProduct(id, amount, sold)) {
-            receipt.addItem(sold.name, amount, sold.price);
+        SaleView sold;
+        if (operations.sellProduct(id, amount, sold)) {
+            receipts.current(lane).addItem(sold);
         }
     }
 
-    void showInventory() {
-        inventory.showInventory();
+    void sellBasket() {
+        cout << "=== SELL BASKET ===\n";
+        vector<LineItem> basket = InputHandler::getBasketInput();
+        operations.sellBatch(basket, receipts.current(lane));
     }
 
-    void exportInventory() {
-        string filename = "inventory_" + TimeTools::now_timestamp() + ".txt";
-        if (inventory.printToFile(filename)) {
-            cout << "Inventory exported to " << filename << " :D\n";
+    void searchProducts() {
+        cout << "=== SEARCH PRODUCTS ===\n";
+        string query = InputHandler::getStringInput("Enter name or prefix: ");
+        auto matches = inventory.searchByName(query);
+        if (matches.empty()) {
+            cout << " X No products match \"" << query << "\".\n";
+            return;
+        }
+        if (matches.front().distance > 0) cout << "No exact match. Did you mean:\n";
+        inventory.showProducts(matches);
+    }
+
+    void saveSnapshot() {
+        if (persistence.saveSnapshot(inventory)) {
+            cout << "Snapshot saved to " << persistence.snapshotFile() << " :D\n";
+        } else {
+            cout << " X Failed to save snapshot.\n";
+        }
+    }
+
+    void importCatalog() {
+        cout << "=== IMPORT CATALOG ===\n";
+        string path = InputHandler::getStringInput("Enter file path: ");
+        auto report = CatalogImporter::importFile(path, inventory);
+        if (!report.opened) {
+            cout << " X Cannot open " << path << ".\n";
+            return;
+        }
+        cout << "Imported " << report.accepted << " of " << report.rows << " rows in "
+             << report.seconds << " s (" << static_cast<long long>(report.rowsPerSecond()) << " rows/s)\n";
+        if (report.rejected) {
+            cout << " X Rejected " << report.rejected << " row(s):\n";
+            for (auto& r : report.samples) cout << "   line " << r.line << ": " << r.reason << "\n";
+        }
+        // Imports bypass the write-ahead log, so persist them with a checkpoint.
+        if (report.accepted && !persistence.saveSnapshot(inventory)) {
+            cout << " X Failed to save snapshot after import.\n";
+        }
+        if (report.accepted && replication) replication->resync();
+    }
+
+    void showDashboard() {
+        InventoryTotals totals = inventory.totals();
+        StreamWriter out(cout);
+        out << "=== DASHBOARD ===\n";
+        out << "Products: " << totals.skus << " | Units on hand: " << totals.units << " | Stock value: ";
+        writeMoney(out, totals.stockValue);
+        out << '\n';
+        out << "Empty: " << totals.emptyCount << " | Short: " << totals.shortCount << '\n';
+        auto minutes = chrono::duration_cast<chrono::minutes>(chrono::system_clock::now() - ledger.startedAt());
+        out << "Session (" << static_cast<long long>(minutes.count()) << " min): " << ledger.transactionCount()
+            << " sale(s) | Units sold: " << ledger.unitsSold() << " | Revenue: ";
+        writeMoney(out, ledger.totalRevenue());
+        out << '\n';
+        if (replication) {
+            auto status = replication->currentStatus();
+            out << "Replication (branch " << replication->branchId() << "): "
+                << (status.connected ? "connected" : "offline") << " | Synced to: " << status.acked
+                << " | Queued: " << status.queuedRecords << '\n';
+        }
+    }
+
+    void editPromotions() {
+        {
+            StreamWriter out(cout);
+            out << "=== PROMOTIONS ===\n";
+            if (promotions.size() == 0) out << "No promotions.\n";
+            for (auto& rule : promotions.promotions()) {
+                out << "ID: " << rule.productId << " | ";
+                rule.writeDescription(out);
+                out << '\n';
+            }
+        }
+        cout << "1. Percent Off\n2. Buy N Get M Free\n3. Bundle (N for a price)\n4. Remove\n0. Back\n";
+        int choice = InputHandler::getIntInput("Choice: ");
+        if (choice < 1 || choice > 4) return;
+
+        Promotion rule;
+        rule.productId = InputHandler::getIntInput("Enter product ID: ");
+        if (choice == 4) {
+            if (!promotions.remove(rule.productId)) {
+                cout << " X No promotion for that product.\n";
+                return;
+            }
+        } else {
+            if (!inventory.productExists(rule.productId)) {
+                cout << " X Product not found.\n";
+                return;
+            }
+            if (choice == 1) {
+                rule.kind = PromotionKind::PercentOff;
+                rule.percent = InputHandler::getIntInput("Percent off (1-100): ");
+            } else if (choice == 2) {
+                rule.kind = PromotionKind::BuyGetFree;
+                rule.buy = InputHandler::getIntInput("Units paid for: ");
+                rule.free = InputHandler::getIntInput("Units free: ");
+            } else {
+                rule.kind = PromotionKind::Bundle;
+                rule.bundleSize = InputHandler::getIntInput("Units in the bundle: ");
+                rule.bundlePrice = toCents(InputHandler::getDoubleInput("Bundle price: "));
+            }
+            if (!promotions.set(rule)) {
+                cout << " X Invalid promotion.\n";
+                return;
+            }
+        }
+        if (promotions.saveFile(PricingEngine::defaultPath)) {
+            cout << "Promotions updated. :D\n";
+        } else {
+            cout << " X Failed to save promotions.\n";
+        }
+    }
+
+    static bool readLimits(StockLimits& limits) {
+        int capacity = InputHandler::getIntInput("Capacity (units): ");
+        int warning = InputHandler::getIntInput("SHORT below (units): ");
+        if (capacity < 1 || capacity > 0xFFFF || warning < 1 || warning > capacity) return false;
+        limits = StockLimits{static_cast<uint16_t>(capacity), static_cast<uint16_t>(warning)};
+        return true;
+    }
+
+    void editStockLimits() {
+        if (!StockPolicy::configurable) {
+            cout << " X Stock limits are fixed in this build.\n";
+            return;
+        }
+        {
+            StreamWriter out(cout);
+            out << "=== STOCK LIMITS ===\n";
+            auto names = stockLimits.classNames();
+            auto limits = stockLimits.limits();
+            for (size_t c = 0; c < names.size(); ++c) {
+                out << "Class: " << names[c] << " | Capacity: " << limits[c].capacity
+                    << " | SHORT below: " << limits[c].warning << '\n';
+            }
+            out << "Products outside standard: " << stockLimits.assignments().size() << '\n';
+        }
+        cout << "1. Define Class\n2. Assign Product to Class\n3. Set Product Limits\n4. Show Product\n0. Back\n";
+        int choice = InputHandler::getIntInput("Choice: ");
+        if (choice < 1 || choice > 4) return;
+
+        StockLimitTable edited = stockLimits;
+        StockLimits limits;
+        if (choice == 1) {
+            string name = InputHandler::getStringInput("Class name (one word): ");
+            if (!readLimits(limits) || !edited.defineClass(name, limits)) {
+                cout << " X Invalid class.\n";
+                return;
+            }
+        } else {
+            int id = InputHandler::getIntInput("Enter product ID: ");
+            if (!inventory.productExists(id)) {
+                cout << " X Product not found.\n";
+                return;
+            }
+            if (choice == 4) {
+                limits = stockLimits.limitsOf(id);
+                cout << "Class: " << stockLimits.classOf(id) << " | Capacity: " << limits.capacity
+                     << " | SHORT below: " << limits.warning << "\n";
+                return;
+            }
+            bool ok = choice == 2 ? edited.assign(id, InputHandler::getStringInput("Class name: "))
+                                  : readLimits(limits) && edited.setProduct(id, limits);
+            if (!ok) {
+                cout << (choice == 2 ? " X Unknown class.\n" : " X Invalid limits.\n");
+                return;
+            }
+        }
+        int overfull = 0;
+        if (!inventory.setStockLimits(edited, &overfull)) {
+            cout << " X Product ID " << overfull << " already holds more than its new capacity.\n";
+            return;
+        }
+        stockLimits = move(edited);
+        if (stockLimits.saveFile(StockLimitTable::defaultPath)) {
+            cout << "Stock limits updated. :D\n";
+        } else {
+            cout << " X Failed to save stock limits.\n";
+        }
+    }
+
+    void salesReports() {
+        cout << "=== SALES REPORTS ===\n";
+        cout << "1. Revenue by Day\n2. Top Sellers\n3. Units per Hour\n0. Back\n";
+        int choice = InputHandler::getIntInput("Choice: ");
+        if (choice < 1 || choice > 3) return;
+        int productId = choice == 3 ? InputHandler::getIntInput("Enter product ID: ") : 0;
+        int days = InputHandler::getIntInput("Days back (1 = today): ");
+        if (days < 1) {
+            cout << " X Invalid number of days.\n";
+            return;
+        }
+        int32_t toDay = SalesHistory::today();
+        int32_t fromDay = toDay - (days - 1);
+
+        StreamWriter out(cout);
+        if (choice == 1) {
+            auto rows = history.revenueByDay(fromDay, toDay);
+            if (rows.empty()) out << "No sales.\n";
+            Cents total = 0;
+            for (auto& row : rows) {
+                SalesHistory::writeDay(out, row.day);
+                out << " | Units: " << row.units << " | Revenue: ";
+                writeMoney(out, row.revenue);
+                out << '\n';
+                total += row.revenue;
+            }
+            out << "Total revenue: ";
+            writeMoney(out, total);
+            out << '\n';
+        } else if (choice == 2) {
+            auto rows = history.topSellers(fromDay, toDay, 10);
+            if (rows.empty()) out << "No sales.\n";
+            for (size_t i = 0; i < rows.size(); ++i) {
+                Product product;
+                bool known = inventory.findProduct(rows[i].id, product);
+                out << (i + 1) << ". ID: " << rows[i].id << " | Name: " << (known ? product.name : "(deleted)")
+                    << " | Units: " << rows[i].units << " | Revenue: ";
+                writeMoney(out, rows[i].revenue);
+                out << '\n';
+            }
+        } else {
+            auto hours = history.unitsPerHour(productId, fromDay, toDay);
+            long long total = 0;
+            for (int hour = 0; hour < 24; ++hour) {
+                if (hours[hour] == 0) continue;
+                out << (hour < 10 ? "0" : "") << hour << ":00 | Units: " << hours[hour] << '\n';
+                total += hours[hour];
+            }
+            out << "Product " << productId << ": " << total << " unit(s)\n";
+        }
+        out << "(" << history.rows() << " sale rows in " << history.partitionCount() << " day(s), "
+            << history.columnBytes() << " bytes of columns)\n";
+    }
+
+    void showMetrics() {
+        if (!metrics) {
+            cout << " X Metrics are off (started with --no-metrics).\n";
+            return;
+        }
+        {
+            StreamWriter out(cout);
+            metrics->writeText(out);
+        }
+        string filename = TimeTools::uniqueFileName("metrics_", ".json");
+        if (metrics->printToFile(filename)) {
+            cout << "Metrics written to " << filename << " :D\n";
         } else {
-            cout << " X Failed to export inventory.\n";
+            cout << " X Failed to write metrics.\n";
         }
     }
 
     void exportReceipt() {
-        if (receipt.isEmpty()) {
+        if (!receipts.hasItems(lane)) {
             cout << " X No items in receipt to export.\n";
             return;
         }
-        string filename = "receipt_" + TimeTools::now_timestamp() + ".txt";
-        if (receipt.printToFile(filename)) {
+        string filename = TimeTools::uniqueFileName("receipt_", ".txt");
+        if (finishReceipt(filename)) {
             cout << "Receipt exported to " << filename << " :D\n";
         } else {
             cout << " X Failed to export receipt.\n";
@@ -529,19 +7409,21 @@ private:
 
 class InventoryManagerMenu : public MainMenu {
 public:
-    InventoryManagerMenu(Inventory& inv, Reciept& rec) : MainMenu(inv, rec) {}
+    explicit InventoryManagerMenu(const MenuContext& app) : MainMenu(app) {}
 
     void show() override {
         while (true) {
             ScreenManager::clearScreen();
+            reportExports();
             cout << "\n=== INVENTORY MANAGER MENU ===\n";
             cout << "1. Insert Product\n2. Delete Product\n3. Restock\n";
-            cout << "4. Show Inventory\n5. Export Inventory\n6. Back\n";
+            cout << "4. Show Inventory\n5. Export Inventory\n6. Save Snapshot\n7. Import Catalog\n";
+            cout << "8. Restock Queue\n9. Restock All To N\n10. Restock Plan\n11. Back\n";
             cout << "Choice: ";
 
             int choice = InputHandler::getIntInput("");
 
-            if (choice == 6) break;
+            if (choice == 11) break;
 
             processChoice(choice);
         }
@@ -554,8 +7436,13 @@ private:
             case 1: insertProduct(); break;
             case 2: deleteProduct(); break;
             case 3: restockProduct(); break;
-            case 4: showInventory(); break;
+            case 4: browseInventory(); break;
             case 5: exportInventory(); break;
+            case 6: saveSnapshot(); break;
+            case 7: importCatalog(); break;
+            case 8: showRestockQueue(); break;
+            case 9: restockAll(); break;
+            case 10: restockPlan(); break;
             default: cout << "Invalid choice.\n"; break;
         }
         ScreenManager::pauseForUser();
@@ -564,50 +7451,114 @@ private:
     void insertProduct() {
         cout << "=== INSERT PRODUCT ===\n";
         Product p = InputHandler::getProductInput();
-        inventory.insertProduct(p);
+        operations.insertProduct(p);
     }
 
     void deleteProduct() {
         cout << "=== DELETE PRODUCT ===\n";
         int id = InputHandler::getIntInput("Enter product ID to delete: ");
-        inventory.deleteProduct(id);
+        operations.deleteProduct(id);
     }
 
     void restockProduct() {
         cout << "=== RESTOCK PRODUCT ===\n";
         int id = InputHandler::getIntInput("Enter product ID: ");
         int amount = InputHandler::getIntInput("Enter amount to restock: ");
-        inventory.restockProduct(id, amount);
+        operations.restockProduct(id, amount);
     }
 
-    void showInventory() {
-        inventory.showInventory();
+    void showRestockQueue() {
+        StreamWriter out(cout);
+        inventory.writeRestockQueue(out);
     }
 
-    void exportInventory() {
-        string filename = "inventory_" + TimeTools::now_timestamp() + ".txt";
-        if (inventory.printToFile(filename)) {
-            cout << "Inventory exported to " << filename << " :D\n";
+    void restockAll() {
+        cout << "=== RESTOCK ALL ===\n";
+        int target = InputHandler::getIntInput("Restock every queued product up to: ");
+        if (target <= 0 || target > 0xFFFF) { // restockAllTo clamps to each capacity
+            cout << "X Target must be between 1 and 65535.\n";
+            return;
+        }
+        size_t restocked = inventory.restockAllTo(target);
+        cout << "Restocked " << restocked << " product(s) to " << target << ".\n";
+    }
+
+    // Forecast-driven orders from the sales history, applied as one batch.
+    void restockPlan() {
+        ForecastSettings settings;
+        auto plan = RestockPlanner::plan(inventory, history, settings);
+        {
+            StreamWriter out(cout);
+            out << "=== RESTOCK PLAN (last " << settings.windowDays << " days, " << settings.leadTimeDays
+                << "-day lead time) ===\n";
+            if (plan.empty()) {
+                out << "Nothing to order.\n";
+                return;
+            }
+            for (auto& s : plan) {
+                Product product;
+                inventory.findProduct(s.id, product);
+                out << "ID: " << s.id << " | Name: " << product.name << " | Qty: " << s.stock
+                    << " | Sells/day: " << s.dailyDemand << " | Reorder at: " << s.reorderPoint
+                    << " | Order: " << s.amount << '\n';
+            }
+        }
+        if (InputHandler::getIntInput("Apply plan? (1 = yes, 0 = no): ") != 1) return;
+        vector<LineItem> lines;
+        lines.reserve(plan.size());
+        for (auto& s : plan) lines.push_back(LineItem{s.id, s.amount});
+        size_t restocked = inventory.restockBatch(lines);
+        cout << "Restocked " << restocked << " of " << lines.size() << " product(s).\n";
+    }
+
+    void saveSnapshot() {
+        if (persistence.saveSnapshot(inventory)) {
+            cout << "Snapshot saved to " << persistence.snapshotFile() << " :D\n";
         } else {
-            cout << " X Failed to export inventory.\n";
+            cout << " X Failed to save snapshot.\n";
         }
     }
+
+    void importCatalog() {
+        cout << "=== IMPORT CATALOG ===\n";
+        string path = InputHandler::getStringInput("Enter file path: ");
+        auto report = CatalogImporter::importFile(path, inventory);
+        if (!report.opened) {
+            cout << " X Cannot open " << path << ".\n";
+            return;
+        }
+        cout << "Imported " << report.accepted << " of " << report.rows << " rows in "
+             << report.seconds << " s (" << static_cast<long long>(report.rowsPerSecond()) << " rows/s)\n";
+        if (report.rejected) {
+            cout << " X Rejected " << report.rejected << " row(s):\n";
+            for (auto& r : report.samples) cout << "   line " << r.line << ": " << r.reason << "\n";
+        }
+        // Imports bypass the write-ahead log, so persist them with a checkpoint.
+        if (report.accepted && !persistence.saveSnapshot(inventory)) {
+            cout << " X Failed to save snapshot after import.\n";
+        }
+        if (report.accepted && replication) replication->resync();
+    }
 };
 
 class CashierMenu : public MainMenu {
 public:
-    CashierMenu(Inventory& inv, Reciept& rec) : MainMenu(inv, rec) {}
+    explicit CashierMenu(const MenuContext& app) : MainMenu(app) {
+        lane = 1; // lane 0 belongs to the admin
+    }
 
     void show() override {
         while (true) {
             ScreenManager::clearScreen();
-            cout << "\n=== CASHIER MENU ===\n";
-            cout << "1. Sell Product\n2. Show Inventory\n3. Export Receipt\n4. Back\n";
+            reportExports();
+            cout << "\n=== CASHIER MENU (lane " << lane << ") ===\n";
+            cout << "1. Sell Product\n2. Show Inventory\n3. Export Receipt\n4. Sell Basket\n";
+            cout << "5. Search Products\n6. Switch Lane\n7. Scan Barcode\n8. Back\n";
             cout << "Choice: ";
 
             int choice = InputHandler::getIntInput("");
 
-            if (choice == 4) break;
+            if (choice == 8) break;
 
             processChoice(choice);
         }
@@ -618,34 +7569,62 @@ private:
         ScreenManager::clearScreen();
         switch (choice) {
             case 1: sellProduct(); break;
-            case 2: showInventory(); break;
+            case 2: browseInventory(); break;
             case 3: exportReceipt(); break;
+            case 4: sellBasket(); break;
+            case 5: searchProducts(); break;
+            case 6: switchLane(); break;
+            case 7: scanBarcode(); break;
             default: cout << "X Invalid choice.\n"; break;
         }
         ScreenManager::pauseForUser();
     }
 
+    void switchLane() {
+        int next = InputHandler::getIntInput("Enter lane (1-" + to_string(ReceiptSessions::kMaxLanes - 1) + "): ");
+        if (next < 1 || !ReceiptSessions::validLane(next)) {
+            cout << "X Invalid lane.\n";
+            return;
+        }
+        lane = next;
+        cout << "Now serving lane " << lane << (receipts.hasItems(lane) ? " (open receipt)" : "") << ".\n";
+    }
+
     void sellProduct() {
         cout << "=== SELL PRODUCT ===\n";
         int id = InputHandler::getIntInput("Enter product ID: ");
         int amount = InputHandler::getIntInput("Enter quantity to sell: ");
-        Product sold;
-        if (inventory.sellProduct(id, amount, sold)) {
-            receipt.addItem(sold.name, amount, sold.price);
+        SaleView sold;
+        if (operations.sellProduct(id, amount, sold)) {
+            receipts.current(lane).addItem(sold);
         }
     }
 
-    void showInventory() {
-        inventory.showInventory();
+    void sellBasket() {
+        cout << "=== SELL BASKET ===\n";
+        vector<LineItem> basket = InputHandler::getBasketInput();
+        operations.sellBatch(basket, receipts.current(lane));
+    }
+
+    void searchProducts() {
+        cout << "=== SEARCH PRODUCTS ===\n";
+        string query = InputHandler::getStringInput("Enter name or prefix: ");
+        auto matches = inventory.searchByName(query);
+        if (matches.empty()) {
+            cout << "X No products match \"" << query << "\".\n";
+            return;
+        }
+        if (matches.front().distance > 0) cout << "No exact match. Did you mean:\n";
+        inventory.showProducts(matches);
     }
 
     void exportReceipt() {
-        if (receipt.isEmpty()) {
+        if (!receipts.hasItems(lane)) {
             cout << "X No items in receipt to export.\n";
             return;
         }
-        string filename = "receipt_" + TimeTools::now_timestamp() + ".txt";
-        if (receipt.printToFile(filename)) {
+        string filename = TimeTools::uniqueFileName("receipt_", ".txt");
+        if (finishReceipt(filename)) {
             cout << " Receipt exported to " << filename << " :D\n";
         }
         else {
@@ -655,26 +7634,150 @@ private:
 };
 
 // --------------------------------------APP
+struct AppOptions {
+    WriteAheadLog::CommitMode commitMode = WriteAheadLog::CommitMode::Sync;
+    bool metrics = true;
+    string replicateTo; // "host:port" of a ReplicationHub, empty to stay local
+    uint32_t branch = 1;
+    IndexMode index = IndexMode::FlatHash; // --dense-ids
+};
+
 class SupermarketApp {
 private:
     Inventory inventory;
-    Reciept receipt;
+    PricingEngine promotions;
+    StockLimitTable stockLimits;
+    SalesHistory history;
+    ReceiptPool receiptPool;
+    ReceiptSessions receipts{receiptPool, &promotions, &history};
+    InventoryPersistence persistence;
+    SalesLedger ledger;
+    unique_ptr<TeeInventoryEvents> ledgerEvents;
+    InventoryMetrics metrics;
+    unique_ptr<MeteredInventory> metered; // null when metrics are off
+    AsyncExporter exporter; // its destructor finishes queued exports before the app exits
+    unique_ptr<ReplicationSender> replication; // declared after persistence: stops before the log closes
+    string notice; // shown once under the login menu
+
+    MenuContext context() {
+        ICheckoutOperations& operations = metered ? static_cast<ICheckoutOperations&>(*metered) : inventory;
+        return MenuContext{inventory, operations, receipts, persistence, ledger, history, exporter, promotions,
+                           stockLimits, metered ? &metrics : nullptr, replication.get()};
+    }
+
+    void dumpMetrics() {
+        if (!metered) return;
+        if (metrics.printToFile(metricsPath)) cout << "Metrics written to " << metricsPath << "\n";
+    }
 
 public:
+    static constexpr const char* metricsPath = "metrics.json";
+
+    explicit SupermarketApp(AppOptions options = {})
+        : inventory(options.index),
+          persistence(InventorySnapshot::defaultPath, WriteAheadLog::defaultPath, options.commitMode) {
+        if (options.metrics) metered = make_unique<MeteredInventory>(inventory, metrics);
+        // Limits first: snapshot and log hold stock levels only valid under them.
+        size_t limitLines = stockLimits.loadFile(StockLimitTable::defaultPath);
+        bool limitsApplied = inventory.setStockLimits(stockLimits);
+        auto restored = persistence.restore(inventory);
+        ledgerEvents = make_unique<TeeInventoryEvents>(inventory.eventSink(), ledger);
+        inventory.setEventSink(*ledgerEvents);
+        stringstream ss;
+        if (restored.snapshot.ok) {
+            ss << "Loaded " << restored.snapshot.loaded << " products from " << persistence.snapshotFile()
+               << " in " << restored.snapshot.millis << " ms";
+            if (restored.snapshot.rejected) ss << " (" << restored.snapshot.rejected << " rejected)";
+            if (restored.snapshot.warm) {
+                const WarmLoadTimings& t = restored.snapshot.stages;
+                ss << "\n  parse " << t.parse << " ms | merge " << t.merge << " ms | columns " << t.columns
+                   << " ms | indexes " << t.indexes << " ms";
+            }
+            ss << "\n";
+        }
+        if (restored.log.applied) {
+            ss << "Replayed " << restored.log.applied << " logged change(s) since the last snapshot\n";
+        }
+        if (!restored.journaling) {
+            ss << " X Write-ahead log unavailable; changes will not survive a crash\n";
+        }
+        if (limitLines && limitsApplied) {
+            ss << "Loaded " << limitLines << " stock limit line(s) from " << StockLimitTable::defaultPath << "\n";
+        } else if (limitLines) {
+            ss << " X Stock limits are fixed in this build; ignoring " << StockLimitTable::defaultPath << "\n";
+        }
+        if (size_t rules = promotions.loadFile(PricingEngine::defaultPath)) {
+            ss << "Loaded " << rules << " promotion(s) from " << PricingEngine::defaultPath << "\n";
+        }
+        if (!history.open(SalesHistory::defaultPath)) {
+            ss << " X Cannot use " << SalesHistory::defaultPath << "; sales history is kept in memory only\n";
+        } else if (history.rows()) {
+            ss << "Loaded " << history.rows() << " sale row(s) over " << history.partitionCount() << " day(s) from "
+               << SalesHistory::defaultPath << "\n";
+        }
+        if (!options.replicateTo.empty()) {
+            string host;
+            uint16_t port = 0;
+            if (!restored.journaling) {
+                ss << " X Replication needs the write-ahead log; staying local\n";
+            } else if (!ReplicationProtocol::parseEndpoint(options.replicateTo, host, port)) {
+                ss << " X Invalid replication address " << options.replicateTo << "\n";
+            } else {
+                replication = make_unique<ReplicationSender>(host, port, options.branch, persistence);
+                ss << "Replicating as branch " << options.branch << " to " << host << ":" << port << "\n";
+            }
+        }
+        notice = ss.str();
+    }
+
     void run() {
-        while (true) {
-            ScreenManager::clearScreen();
-            showMainMenu();
+        try {
+            while (true) {
+                ScreenManager::clearScreen();
+                showMainMenu();
 
-            int role = InputHandler::getIntInput("Enter choice: ");
+                int role = InputHandler::getIntInput("Enter choice: ");
 
-            if (role == 4) {
-                cout << "Goodbye! :D\n";
-                break;
+                if (role == 4) {
+                    cout << "Goodbye! :D\n";
+                    break;
+                }
+
+                handleRoleSelection(role);
             }
+        } catch (const InputClosed&) {
+            cout << "\nInput closed. Goodbye! :D\n";
+        }
+        dumpMetrics();
+    }
 
-            handleRoleSelection(role);
+    // Batch mode: the script holds exactly what a user would type, one answer per line,
+    // and is fed through the same menus with no screen clearing, no pauses and
+    // fully buffered output.
+    bool runScript(const string& filepath) {
+        ifstream script(filepath);
+        if (!script.is_open()) {
+            cerr << " X Cannot open script " << filepath << "\n";
+            return false;
         }
+
+        static char outputBuffer[1 << 16];
+        cout.rdbuf()->pubsetbuf(outputBuffer, sizeof(outputBuffer));
+        ostream* tied = cin.tie(nullptr);
+        streambuf* console = cin.rdbuf(script.rdbuf());
+        ScreenManager::setHeadless(true);
+
+        auto start = chrono::steady_clock::now();
+        run();
+        cout.flush();
+        persistence.log().sync();
+        cerr << "Script finished in "
+             << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms\n";
+
+        ScreenManager::setHeadless(false);
+        cin.rdbuf(console);
+        cin.tie(tied);
+        return true;
     }
 
 private:
@@ -687,6 +7790,10 @@ private:
         cout << "3. Cashier\n";
         cout << "4. Exit\n";
         cout << "------------------------------\n";
+        if (!notice.empty()) {
+            cout << notice;
+            notice.clear();
+        }
     }
 
     void handleRoleSelection(int role) {
@@ -694,13 +7801,13 @@ private:
 
         switch (role) {
             case 1:
-                menu = make_unique<AdminMenu>(inventory, receipt);
+                menu = make_unique<AdminMenu>(context());
                 break;
             case 2:
-                menu = make_unique<InventoryManagerMenu>(inventory, receipt);
+                menu = make_unique<InventoryManagerMenu>(context());
                 break;
             case 3:
-                menu = make_unique<CashierMenu>(inventory, receipt);
+                menu = make_unique<CashierMenu>(context());
                 break;
             default:
                 cout << " X Invalid choice.\n";
@@ -713,10 +7820,206 @@ private:
 };
 
 // --------------------------------------Main
-int main() {
-    SupermarketApp app;
+#ifndef SUPERMARKET_NO_MAIN
+// Counting allocator for InventoryMetrics. Benchmarks include this file with
+// SUPERMARKET_NO_MAIN and bring their own.
+// Kept out of line so GCC does not pair the inlined free() with a plain new.
+[[gnu::noinline]] void* operator new(size_t size) {
+    ++AllocationCounter::count;
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void* p) noexcept { free(p); }
+[[gnu::noinline]] void operator delete(void* p, size_t) noexcept { free(p); }
+
+// Headquarters console: "stock <id>", "totals", "quit".
+static int runHub(const char* portText) {
+    unsigned port = 0;
+    auto [end, ec] = from_chars(portText, portText + strlen(portText), port);
+    ReplicationHub hub;
+    if (ec != errc() || *end || port > 0xFFFF || !hub.start(static_cast<uint16_t>(port))) {
+        cerr << " X Cannot listen on port " << portText << "\n";
+        return 1;
+    }
+    cout << "Replication hub listening on port " << hub.port() << "\n";
+    string line;
+    while (cout << "hub> " << flush && getline(cin, line)) {
+        istringstream command(line);
+        string verb;
+        command >> verb;
+        StreamWriter out(cout);
+        int id = 0;
+        if (verb == "stock" && command >> id) {
+            ReplicationReport::writeStock(out, id, hub.stockOf(id));
+        } else if (verb == "totals") {
+            ReplicationReport::writeTotals(out, hub.totals());
+        } else if (verb == "quit") {
+            break;
+        } else if (!verb.empty()) {
+            out << "Commands: stock <id> | totals | quit\n";
+        }
+    }
+    return 0;
+}
+
+// Store server: loads the snapshot and log like the console app, journals every
+// served change to the same log and checkpoints on "quit".
+static int runServer(uint16_t port, size_t threads, IndexMode index) {
+#ifdef __linux__
+    InventoryPersistence persistence(InventorySnapshot::defaultPath, WriteAheadLog::defaultPath,
+                                     WriteAheadLog::CommitMode::Async);
+    StockLimitTable limits;
+    limits.loadFile(StockLimitTable::defaultPath);
+    Inventory loaded(index);
+    loaded.setEventSink(NullInventoryEvents::instance());
+    loaded.setStockLimits(limits);
+    auto restored = persistence.restore(loaded);
+    ConcurrentInventory store(16, index);
+    store.setEventSink(NullInventoryEvents::instance());
+    store.setStockLimits(limits);
+    vector<Product> products;
+    loaded.appendProducts(products);
+    for (auto& p : products) store.insertProduct(p);
+    if (restored.journaling) store.setEventSink(persistence.log());
+    else cerr << " X Write-ahead log unavailable; changes will not survive a crash\n";
+
+    InventoryServer server(store, restored.journaling ? &persistence.log() : nullptr);
+    if (!server.start(port, threads)) {
+        cerr << " X Cannot listen on port " << port << "\n";
+        return 1;
+    }
+    cout << "Serving " << store.size() << " products on port " << server.port() << " (" << threads
+         << " event loop(s))\n";
+    // Reports read snapshots, so they never hold up the terminals.
+    AsyncExporter exporter;
+    string line;
+    while (cout << "store> " << flush && getline(cin, line)) {
+        if (line == "quit") break;
+        if (line == "stats") {
+            auto stats = server.stats();
+            cout << "Requests: " << stats.requests << " | Batches: " << stats.batches
+                 << " | Connections: " << stats.connections << "\n";
+        } else if (line == "totals") {
+            InventoryTotals totals = store.snapshot()->totals();
+            StreamWriter out(cout);
+            out << "Products: " << totals.skus << " | Units on hand: " << totals.units << " | Stock value: ";
+            writeMoney(out, totals.stockValue);
+            out << "\n";
+        } else if (line == "export") {
+            string filename = TimeTools::uniqueFileName("inventory_", ".txt");
+            auto done = exporter.submit(store.snapshot(), filename).get();
+            if (done.ok) cout << "Inventory exported to " << filename << " (" << done.products << " products)\n";
+            else cout << " X Failed to export inventory to " << filename << ".\n";
+        } else if (!line.empty()) {
+            cout << "Commands: stats | totals | export | quit\n";
+        }
+    }
+    server.stop();
+
+    Inventory final(index);
+    final.setEventSink(NullInventoryEvents::instance());
+    final.setStockLimits(limits);
+    for (auto& p : store.sortedProducts()) final.loadProduct(p.id, p.name, p.quantity, p.price, p.barcode);
+    if (!persistence.saveSnapshot(final)) {
+        cerr << " X Failed to save snapshot.\n";
+        return 1;
+    }
+    cout << "Snapshot saved to " << persistence.snapshotFile() << "\n";
+    return 0;
+#else
+    (void)port;
+    (void)threads;
+    (void)index;
+    cerr << " X Server mode needs Linux (epoll)\n";
+    return 1;
+#endif
+}
+
+static int runQuery(const string& endpoint, const string& what, const char* idText) {
+    string host;
+    uint16_t port = 0;
+    if (!ReplicationProtocol::parseEndpoint(endpoint, host, port)) {
+        cerr << " X Invalid hub address " << endpoint << "\n";
+        return 2;
+    }
+    StreamWriter out(cout);
+    if (what == "stock" && idText) {
+        int id = atoi(idText);
+        vector<BranchStock> rows;
+        if (!ReplicationClient::queryStock(host, port, id, rows)) {
+            cerr << " X Hub at " << endpoint << " did not answer\n";
+            return 1;
+        }
+        ReplicationReport::writeStock(out, id, rows);
+        return 0;
+    }
+    vector<BranchTotals> rows;
+    if (what != "totals" || !ReplicationClient::queryTotals(host, port, rows)) {
+        cerr << " X Hub at " << endpoint << " did not answer\n";
+        return 1;
+    }
+    ReplicationReport::writeTotals(out, rows);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    // supermarket [--no-metrics] [--dense-ids] [--script commands.txt] [--replicate host:port --branch N]
+    // supermarket --gen-barcode-table catalog.csv catalog_barcodes.inc
+    // supermarket --hub port
+    // supermarket --query host:port stock <id> | totals
+    // supermarket --serve port [--threads N] [--dense-ids]
+    AppOptions options;
+    const char* script = nullptr;
+    const char* serve = nullptr;
+    size_t serveThreads = 4;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--script" && i + 1 < argc) {
+            script = argv[++i];
+        } else if (arg == "--no-metrics") {
+            options.metrics = false;
+        } else if (arg == "--dense-ids") {
+            options.index = IndexMode::Dense;
+        } else if (arg == "--gen-barcode-table" && i + 2 < argc) {
+            return generateBarcodeTable(argv[i + 1], argv[i + 2]) ? 0 : 1;
+        } else if (arg == "--replicate" && i + 1 < argc) {
+            options.replicateTo = argv[++i];
+        } else if (arg == "--branch" && i + 1 < argc) {
+            options.branch = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--hub" && i + 1 < argc) {
+            return runHub(argv[i + 1]);
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serve = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            serveThreads = max<size_t>(strtoul(argv[++i], nullptr, 10), 1);
+        } else if (arg == "--query" && i + 2 < argc) {
+            return runQuery(argv[i + 1], argv[i + 2], i + 3 < argc ? argv[i + 3] : nullptr);
+        } else {
+            cerr << "Usage: " << argv[0]
+                 << " [--no-metrics] [--dense-ids] [--script commands.txt] [--replicate host:port --branch N]\n"
+                 << "       " << argv[0] << " --gen-barcode-table catalog.csv catalog_barcodes.inc\n"
+                 << "       " << argv[0] << " --hub port\n"
+                 << "       " << argv[0] << " --query host:port stock <id> | totals\n"
+                 << "       " << argv[0] << " --serve port [--threads N] [--dense-ids]\n";
+            return 2;
+        }
+    }
+
+    if (serve) return runServer(static_cast<uint16_t>(strtoul(serve, nullptr, 10)), serveThreads, options.index);
+
+    if (script) {
+        // Replay a command script at full speed.
+        ios::sync_with_stdio(false);
+        options.commitMode = WriteAheadLog::CommitMode::Async;
+        SupermarketApp app(options);
+        return app.runScript(script) ? 0 : 1;
+    }
+
+    SupermarketApp app(options);
     app.run();
     return 0;
 
 }
+#endif
 //APP MADE BY : MAZEN THABET :)
\ No newline at end of file